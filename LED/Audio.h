@@ -1,7 +1,153 @@
 /*
  * Manages converting audio volume to discreet levels.
  */
-#define AUDIODEBUG true
+#include <EEPROM.h>
+//Sends a compact binary record of the level model over Serial once a second
+#define AUDIODEBUG false
+
+/*
+ * Gain applied to rising audio levels, in 1/4096ths, indexed by how far the level is above 30.
+ * Kp_p^(1 - 5/max(5, audiolevel - 30)) with Kp_p = 0.015. As the level gets closer to 30 the gain gets closer to 1,
+ * making the model very sensitive to sounds at low volumes.
+ */
+const uint16_t rising_gain[256] PROGMEM = {
+  4096, 4096, 4096, 4096, 4096, 4096, 2034, 1234,  848,  633,  502,  414,  354,  309,  275,  249,
+   228,  211,  197,  186,  176,  167,  160,  153,  147,  142,  138,  134,  130,  127,  124,  121,
+   118,  116,  114,  112,  110,  108,  107,  105,  104,  103,  101,  100,   99,   98,   97,   96,
+    95,   94,   94,   93,   92,   91,   91,   90,   89,   89,   88,   88,   87,   87,   86,   86,
+    85,   85,   84,   84,   84,   83,   83,   83,   82,   82,   82,   81,   81,   81,   80,   80,
+    80,   80,   79,   79,   79,   79,   78,   78,   78,   78,   78,   77,   77,   77,   77,   77,
+    76,   76,   76,   76,   76,   76,   75,   75,   75,   75,   75,   75,   75,   74,   74,   74,
+    74,   74,   74,   74,   74,   74,   73,   73,   73,   73,   73,   73,   73,   73,   73,   72,
+    72,   72,   72,   72,   72,   72,   72,   72,   72,   72,   72,   71,   71,   71,   71,   71,
+    71,   71,   71,   71,   71,   71,   71,   71,   71,   70,   70,   70,   70,   70,   70,   70,
+    70,   70,   70,   70,   70,   70,   70,   70,   70,   70,   70,   69,   69,   69,   69,   69,
+    69,   69,   69,   69,   69,   69,   69,   69,   69,   69,   69,   69,   69,   69,   69,   69,
+    69,   69,   68,   68,   68,   68,   68,   68,   68,   68,   68,   68,   68,   68,   68,   68,
+    68,   68,   68,   68,   68,   68,   68,   68,   68,   68,   68,   68,   68,   68,   68,   68,
+    67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67,
+    67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67,   67
+};
+//the same gain in coarser steps above that, every 16 levels from 256 to 1024 above 30, where it barely changes
+#define RISING_GAIN_HIGH_START 256
+#define RISING_GAIN_HIGH_STEP_SHIFT 4
+const uint16_t rising_gain_high[49] PROGMEM = {
+    67,   66,   66,   66,   66,   65,   65,   65,   65,   65,   65,   65,   64,   64,   64,   64,
+    64,   64,   64,   64,   64,   64,   64,   64,   63,   63,   63,   63,   63,   63,   63,   63,
+    63,   63,   63,   63,   63,   63,   63,   63,   63,   63,   63,   63,   63,   63,   63,   63,
+    63
+};
+
+//most levels a LevelConfig can describe
+#define MAX_LEVELS 6
+//where the level config is stored in EEPROM
+#define LEVEL_CONFIG_ADDRESS 0
+//identifies a stored config, change if LevelConfig changes
+#define LEVEL_CONFIG_MAGIC 0x4C31
+
+/*
+ * Thresholds and timings seperating the sound levels. Boundary i seperates level i from level i+1.
+ * Stored in EEPROM, and editable from the serial console.
+ */
+struct LevelConfig {
+  unsigned int magic;
+  //the number of levels
+  byte levels;
+  //the audio level thresholds seperating levels
+  int threshold[MAX_LEVELS-1];
+  //histerisis for moving from higher to lower levels
+  byte negative_hysteresis[MAX_LEVELS-1];
+  //histerisis for moving from lower to higher levels
+  byte positive_hysteresis[MAX_LEVELS-1];
+  //how long (seconds) must a new level be sustationed to transition
+  byte duration_negative[MAX_LEVELS-1];
+  byte duration_positive[MAX_LEVELS-1];
+  byte checksum;
+
+  //the original quiet, medium and loud levels
+  void setDefaults() {
+    magic = LEVEL_CONFIG_MAGIC;
+    levels = 3;
+    for(int i = 0; i < MAX_LEVELS-1; i++) {
+      threshold[i] = 0;
+      negative_hysteresis[i] = 0;
+      positive_hysteresis[i] = 0;
+      duration_negative[i] = 0;
+      duration_positive[i] = 0;
+    }
+    setBoundary(0, /*0<>1*/ 45, 0, 5, 30, 2);
+    setBoundary(1, /*1<>2*/ 70, 0, 5, 30, 10);
+  }
+
+  void setBoundary(int i, int t, byte neg, byte pos, byte dur_neg, byte dur_pos) {
+    threshold[i] = t;
+    negative_hysteresis[i] = neg;
+    positive_hysteresis[i] = pos;
+    duration_negative[i] = dur_neg;
+    duration_positive[i] = dur_pos;
+  }
+
+  //changes the number of levels, new boundaries start just above the previous one
+  void setLevels(byte n) {
+    for(int i = max(levels-1, 0); i < min(n, MAX_LEVELS)-1; i++) {
+      if(i == 0) setBoundary(i, 45, 0, 5, 30, 2);
+      else setBoundary(i, threshold[i-1]+10, negative_hysteresis[i-1], positive_hysteresis[i-1],
+                       duration_negative[i-1], duration_positive[i-1]);
+    }
+    levels = n;
+  }
+
+  //returns NULL if the config is usable, otherwise the reason it isn't
+  const __FlashStringHelper* validate() {
+    if(magic != LEVEL_CONFIG_MAGIC) return F("bad magic");
+    if(levels < 1 || levels > MAX_LEVELS) return F("level count out of range");
+    for(int i = 0; i < levels-1; i++) {
+      if(threshold[i] - negative_hysteresis[i] < 0) return F("threshold below 0");
+      if(threshold[i] + positive_hysteresis[i] > 1023) return F("threshold above 1023");
+      if(i > 0 && threshold[i] <= threshold[i-1]) return F("thresholds must increase");
+      if(duration_negative[i] == 0 || duration_positive[i] == 0) return F("durations must be at least 1s");
+    }
+    return NULL;
+  }
+
+  byte calculateChecksum() {
+    byte sum = 0;
+    const byte *data = (const byte *)this;
+    //everything before the checksum, which needn't be the last byte where ints are padded
+    for(unsigned int i = 0; i < offsetof(LevelConfig, checksum); i++) sum = (sum << 1 | sum >> 7) ^ data[i];
+    return sum;
+  }
+
+  //loads the stored config, or the defaults if none is stored or it is invalid
+  void load() {
+    EEPROM.get(LEVEL_CONFIG_ADDRESS, *this);
+    if(checksum != calculateChecksum() || validate()) setDefaults();
+  }
+
+  void save() {
+    checksum = calculateChecksum();
+    EEPROM.put(LEVEL_CONFIG_ADDRESS, *this);
+  }
+
+  void print() {
+    Serial.print(F("levels "));
+    Serial.println(levels);
+    for(int i = 0; i < levels-1; i++) {
+      Serial.print(F("level "));
+      Serial.print(i);
+      Serial.print(' ');
+      Serial.print(threshold[i]);
+      Serial.print(' ');
+      Serial.print(negative_hysteresis[i]);
+      Serial.print(' ');
+      Serial.print(positive_hysteresis[i]);
+      Serial.print(' ');
+      Serial.print(duration_negative[i]);
+      Serial.print(' ');
+      Serial.println(duration_positive[i]);
+    }
+  }
+};
 
 /*
  * This model produces an average audio level, weighted such that it goes up quicker than down, and is biased against reaching a minimum value
@@ -9,69 +155,104 @@
  */
 class SoundReactor {
 
-  float audiolevel;
+  //average audio level, in 1/256ths
+  long audiolevel;
   int lastvolume;
-  //coefficient controlling the speed audio levels increase
-  const float Kp_p=0.015;
-  //coefficient controlling the speed audio levels decrease
-  const float Kp_n=0.003;
+  //coefficient controlling the speed audio levels decrease, 0.003 in 1/65536ths
+  const long Kp_n=197;
 
   int currentlevel;
   int prospective_level;
   long prospective_level_time;
 
+  //level thresholds and timings
+  LevelConfig config;
   //the number of levels, 0..n
-  const int maxlevel = 2;
-  //the audio level thresholds seperating levels
-  const int thresholds[2] = {/*0<>1*/ 45, /*1<>2*/ 70};
-  //histerisis for moving from lower to higher levels
-  const int threshold_negative_hysteresis[2] = {/*1->0*/ 0, /*2->1*/ 0};
-  //histerisis for moving from higher to lower levels
-  const int threshold_positive_hysteresis[2] = {/*0->1*/ 5, /*1->2*/ 5};
-  //how long (seconds) must a new level be sustationed to transition
-  const int level_minimum_duration_negative[2] = {/*1->0*/ 30, /*2->1*/ 30};
-  const int level_minimum_duration_positive[2] = {/*0->1*/ 2, /*1->2*/10};
-  
+  int maxlevel;
+
   public: SoundReactor() {
-    audiolevel = 70;
+    audiolevel = 70L << 8;
     lastvolume = 0;
     currentlevel = 1;
+    config.setDefaults();
+    maxlevel = config.levels - 1;
+  }
+
+  //loads level config from EEPROM
+  void setup() {
+    config.load();
+    setConfig(config);
+  }
+
+  LevelConfig getConfig() {
+    return config;
   }
 
-  void update(float target) {
+  //Uses a new level config, if it is valid. Returns NULL on success, or the reason the config was rejected.
+  const __FlashStringHelper* setConfig(const LevelConfig& c) {
+    LevelConfig candidate = c;
+    const __FlashStringHelper* error = candidate.validate();
+    if(error) return error;
+    config = candidate;
+    maxlevel = config.levels - 1;
+    currentlevel = min(currentlevel, maxlevel);
+    prospective_level = currentlevel;
+    return NULL;
+  }
+
+  void update(int target) {
     lastvolume = target;
-    int error = target - audiolevel;
+    long error = (long(target) << 8) - audiolevel;
     if(error>0) {
-      //as audiolevel gets closer to 30, Kp_p gets closer to 1
-      //this causes the model to be very sensitive to sounds at low volumes
-      audiolevel += pow(Kp_p, 1.0-5.0/max(5, audiolevel - 30)) * error;
+      audiolevel += (error * risingGain()) >> 12;
     } else {
-      audiolevel += Kp_n * error;
+      audiolevel += (error * Kp_n + 32768) >> 16;
     }
         
     updateLevel();
   }
 
+  //gain for the current level, interpolated between table entries
+  long risingGain() {
+    long above = audiolevel - (30L << 8);
+    if(above < 0) above = 0;
+    int index = above >> 8;
+    if(index < 255) {
+      long low = pgm_read_word(&rising_gain[index]);
+      long high = pgm_read_word(&rising_gain[index + 1]);
+      return low + (((high - low) * (above & 255)) >> 8);
+    }
+    //the last fine entry and the first coarse one are the same
+    above -= long(RISING_GAIN_HIGH_START) << 8;
+    if(above < 0) return pgm_read_word(&rising_gain[255]);
+    index = above >> (8 + RISING_GAIN_HIGH_STEP_SHIFT);
+    if(index >= 48) return pgm_read_word(&rising_gain_high[48]);
+    long low = pgm_read_word(&rising_gain_high[index]);
+    long high = pgm_read_word(&rising_gain_high[index + 1]);
+    return low + (((high - low) * ((above >> RISING_GAIN_HIGH_STEP_SHIFT) & 255)) >> 8);
+  }
+
   int getLastVolume() {
     return lastvolume;
   }
 
   unsigned int getAudioLevel() {
-    return audiolevel;
+    return audiolevel >> 8;
   }
 
   void updateLevel() {
     //thresholds for audio changes
-    int negative_threshold = thresholds[currentlevel-1]-threshold_negative_hysteresis[currentlevel-1];
-    int positive_threshold = thresholds[currentlevel]+threshold_positive_hysteresis[currentlevel];
+    //only valid when there is a level below or above
+    int negative_threshold = currentlevel>0 ? config.threshold[currentlevel-1]-config.negative_hysteresis[currentlevel-1] : 0;
+    int positive_threshold = currentlevel<maxlevel ? config.threshold[currentlevel]+config.positive_hysteresis[currentlevel] : 0;
     //test to see if we should considder going up or down a level
-    if(currentlevel>0 & audiolevel<negative_threshold) {
+    if(currentlevel>0 & audiolevel<(long(negative_threshold)<<8)) {
       if(prospective_level!=currentlevel-1) {
         //start a timer. If audio level remains we will switch after timeout expires
         prospective_level=currentlevel-1;
         prospective_level_time = millis();
       }
-    } else if(currentlevel<maxlevel & audiolevel>positive_threshold) {
+    } else if(currentlevel<maxlevel & audiolevel>(long(positive_threshold)<<8)) {
       if(prospective_level!=currentlevel+1) {
         prospective_level=currentlevel+1;
         prospective_level_time = millis();
@@ -80,39 +261,30 @@ class SoundReactor {
       prospective_level = currentlevel;
     }
 
-    //Debugging
+    /* Debugging, binary record once a second:
+     *  'A', audio level (2 bytes, little endian, 1/256ths), current level, prospective level,
+     *  seconds at prospective level, seconds required to change (0 if not changing) */
     if(AUDIODEBUG && framenumber%30==0) {
-      if(prospective_level<currentlevel) {
-        Serial.println(String(audiolevel) + "<" + String(negative_threshold) + 
-          " " + String(currentlevel) + "->" + String(prospective_level) + 
-          " " + String((millis() - prospective_level_time)/1000) + 
-          "/" + String(level_minimum_duration_negative[currentlevel-1]));
-      } else if(prospective_level>currentlevel) {
-        Serial.println(String(positive_threshold) + "<" + String(audiolevel) +
-          " " + String(currentlevel) + "->" + String(prospective_level) + 
-          " " + String((millis() - prospective_level_time)/1000) + 
-          "/" + String(level_minimum_duration_positive[currentlevel]));
-      } else {
-        if(currentlevel==0) {
-          Serial.println(String(audiolevel) + "<" + String(positive_threshold) + 
-            " " + String(currentlevel));
-        } else if(currentlevel==maxlevel) {
-          Serial.println(String(negative_threshold) + "<" + String(audiolevel) + 
-            " " + String(currentlevel));
-        } else {
-          Serial.println(String(negative_threshold) + "<" + String(audiolevel) + "<" + String(positive_threshold) + 
-            " " + String(currentlevel));
-        }
-      }
+      int required = 0;
+      if(prospective_level<currentlevel) required = config.duration_negative[currentlevel-1];
+      if(prospective_level>currentlevel) required = config.duration_positive[currentlevel];
+      unsigned int level = min(audiolevel, 65535L);
+      Serial.write('A');
+      Serial.write(byte(level & 255));
+      Serial.write(byte(level >> 8));
+      Serial.write(byte(currentlevel));
+      Serial.write(byte(prospective_level));
+      Serial.write(byte(min((millis() - prospective_level_time)/1000, 255UL)));
+      Serial.write(byte(required));
     }
     
     //If we have over the threshold for the specifed time, change levels.
     if(prospective_level<currentlevel & 
-        millis() - prospective_level_time > level_minimum_duration_negative[currentlevel-1]*1000) {
+        millis() - prospective_level_time > config.duration_negative[currentlevel-1]*1000UL) {
       currentlevel = prospective_level;
     }
     if(prospective_level>currentlevel & 
-        millis() - prospective_level_time > level_minimum_duration_positive[currentlevel]*1000) {
+        millis() - prospective_level_time > config.duration_positive[currentlevel]*1000UL) {
       currentlevel = prospective_level;
     }
   }
@@ -122,3 +294,80 @@ class SoundReactor {
 };
 
 SoundReactor soundlevel = SoundReactor();
+
+/*
+ * Detects beats in the volume. A beat is an onset, where the volume jumps well above the mean and spread of recent volumes.
+ * The tempo is estimated from the time between beats. update(int) runs in constant time.
+ */
+class BeatDetector {
+
+    //frames of volume history, about 1.4 seconds
+    static const int HISTORY = 43;
+    //an onset must exceed the mean by 1.5 standard deviations, compared squared: (diff/sd)^2 > 9/4
+    const int ONSET_NUMERATOR = 9;
+    const int ONSET_DENOMINATOR = 4;
+    //and by at least this much, so quiet noise isn't counted
+    const int MINIMUM_RISE = 10;
+    //tempo limits, 200 to 60 bpm
+    const unsigned int MINIMUM_PERIOD = 300;
+    const unsigned int MAXIMUM_PERIOD = 1000;
+
+    SlidingWindow<HISTORY> history;
+    //running sums of the volumes in history, and their squares
+    long sum;
+    long sumsquares;
+    //frame of the last beat, so a beat only lasts the frame it was detected on, even if no reading follows it
+    long beatframe;
+    unsigned long lastbeat;
+    //estimated time between beats, in ms
+    unsigned int period;
+
+  public:
+    BeatDetector() {
+      sum = 0;
+      sumsquares = 0;
+      beatframe = -1;
+      lastbeat = 0;
+      period = 500;
+    }
+
+    void update(int volume) {
+      //remove the value falling out of the window, and add the new one
+      int oldest = history.getVal(0);
+      sum += volume - oldest;
+      sumsquares += long(volume) * volume - long(oldest) * oldest;
+      history.push(volume);
+
+      long mean = sum / HISTORY;
+      long variance = sumsquares / HISTORY - mean * mean;
+      long diff = volume - mean;
+      unsigned long now = millis();
+      bool beat = diff > MINIMUM_RISE &&
+             diff * diff * ONSET_DENOMINATOR > variance * ONSET_NUMERATOR &&
+             now - lastbeat >= MINIMUM_PERIOD;
+      if(beat) {
+        unsigned long interval = now - lastbeat;
+        //follow the tempo slowly, ignoring gaps outside the tempo range
+        if(interval <= MAXIMUM_PERIOD) period += (long(interval) - long(period)) / 4;
+        lastbeat = now;
+        beatframe = framenumber;
+      }
+    }
+
+    //true on the frame a beat was detected
+    bool isBeat() {
+      return beatframe == framenumber;
+    }
+
+    //estimated tempo in beats per minute
+    unsigned int bpm() {
+      return 60000UL / period;
+    }
+
+    //position within the current beat, 0 on the beat to 255 just before the next
+    byte beatPhase() {
+      return ((millis() - lastbeat) % period) * 256 / period;
+    }
+};
+
+BeatDetector beatdetector = BeatDetector();
@@ -0,0 +1,155 @@
+/*
+ * Profiles the cost of every pattern on the board itself.
+ * Enabled by BENCHMARK in LED.ino. Nothing is displayed while it runs, results are sent over Serial.
+ * `make bench` in Test/ runs the same benchmark on a PC, timed by its own clock.
+ */
+
+//approximate time FastLED.show() takes to send a frame to ws2812b leds
+#define SHOW_TIME_US showTimeUs(false)
+//clock the benchmark is timed by, and its ticks per microsecond. The host bench counts nanoseconds.
+#ifndef BENCHMARK_CLOCK
+#define BENCHMARK_CLOCK micros()
+#define BENCHMARK_TICKS_PER_US 1
+#endif
+//number of frames each pattern is run for
+#ifndef BENCHMARK_FRAMES
+#define BENCHMARK_FRAMES 100
+#endif
+
+class PatternBenchmark {
+
+    static const int FRAMES = BENCHMARK_FRAMES;
+    //time each frame took to render, in BENCHMARK_CLOCK ticks
+    unsigned int samples[FRAMES];
+
+  public:
+    PatternBenchmark() {
+    }
+
+    //runs every pattern in turn, and reports the results. frame_time is the frame budget in ms.
+    void run(int frame_time) {
+      Serial.print(F("pattern slot size "));
+      Serial.print(int(PatternArena<patterntypes>::SLOT_SIZE));
+      Serial.println(F(" bytes"));
+      Serial.println(F("pattern mean(ns) p50(ns) p99(ns) cycles/frame crossfade-p50(ns) crossfade-p99(ns) crc"));
+      for (int p = 0; p < PATTERNS::PATTERN_COUNT; p++) {
+        run(p, frame_time);
+      }
+      runOutputStage();
+      Serial.println(F("benchmark done"));
+    }
+
+    void run(int p, int frame_time) {
+      uint16_t crc = render(p, frame_time);
+      unsigned long total = 0;
+      for (int i = 0; i < FRAMES; i++) total += samples[i];
+      sort();
+      unsigned int p50 = samples[FRAMES / 2];
+      unsigned int p99 = samples[FRAMES * 99 / 100];
+      Serial.print(p);
+      Serial.print(' ');
+      Serial.print(nanoseconds(total / FRAMES) + nanoseconds(total % FRAMES) / FRAMES);
+      Serial.print(' ');
+      Serial.print(nanoseconds(p50));
+      Serial.print(' ');
+      Serial.print(nanoseconds(p99));
+      Serial.print(' ');
+      //the clock counts real time, so on the board this is the actual AVR cycle count. On a PC it is the time at 16MHz.
+      Serial.print(total * (F_CPU / 1000000L) / BENCHMARK_TICKS_PER_US / FRAMES);
+      Serial.print(' ');
+      runCrossfade(p);
+      Serial.print(nanoseconds(samples[FRAMES / 2]));
+      Serial.print(' ');
+      Serial.print(nanoseconds(samples[FRAMES * 99 / 100]));
+      Serial.print(' ');
+      Serial.print(crc, HEX);
+      //flag patterns that leave no room for FastLED.show() within the frame
+      unsigned int worst = max(p99, samples[FRAMES * 99 / 100]);
+      if (nanoseconds(worst) > (frame_time * 1000L - SHOW_TIME_US) * 1000) Serial.print(F(" OVER BUDGET"));
+      Serial.println();
+    }
+
+    //renders pattern p for FRAMES frames, timing each. Returns the crc of the frames.
+    uint16_t render(int p, int frame_time) {
+      //every run of a pattern starts the same, and sees time advance a frame at a time,
+      //so its output is repeatable and the crc only changes if the pattern's output does
+      framenumber = 0;
+      patternenvironment.seed(p);
+      patternenvironment.setFrameTime(frame_time);
+      //constructs the pattern, and sets it up
+      levelmanager.getPatternManager()->jump(p);
+      Pattern* pattern = levelmanager.getPatternManager()->getPattern();
+      uint16_t crc = 0xFFFF;
+      for (int i = 0; i < FRAMES; i++) {
+        framenumber++;
+        unsigned long start = BENCHMARK_CLOCK;
+        pattern->update(leds);
+        samples[i] = BENCHMARK_CLOCK - start;
+        crc = frameCrc(crc);
+      }
+      return crc;
+    }
+
+    //times PatternManager crossfading the pattern with itself, the worst case for a transition
+    void runCrossfade(int p) {
+      PatternManager* patternmanager = levelmanager.getPatternManager();
+      patternmanager->jump(p);
+      for (int i = 0; i < FRAMES; i++) {
+        framenumber++;
+        //restart the transition before it completes
+        if (i % 50 == 0) patternmanager->transition(p);
+        unsigned long start = BENCHMARK_CLOCK;
+        patternmanager->update();
+        samples[i] = BENCHMARK_CLOCK - start;
+      }
+      sort();
+    }
+
+    //times the output stage with steady brightness, and when brightness changes every frame
+    void runOutputStage() {
+      OutputStage stage = OutputStage();
+      for (int changing = 0; changing < 2; changing++) {
+        for (int i = 0; i < FRAMES; i++) {
+          unsigned long start = BENCHMARK_CLOCK;
+          stage.setBrightness(changing ? i : 128);
+          stage.apply(leds);
+          samples[i] = BENCHMARK_CLOCK - start;
+        }
+        sort();
+        Serial.print(changing ? F("output stage, brightness changing p50(ns) ") : F("output stage p50(ns) "));
+        Serial.print(nanoseconds(samples[FRAMES / 2]));
+        Serial.print(F(" p99(ns) "));
+        Serial.println(nanoseconds(samples[FRAMES * 99 / 100]));
+      }
+    }
+
+    //a time in BENCHMARK_CLOCK ticks, in ns
+    unsigned long nanoseconds(unsigned long ticks) {
+      return ticks * 1000 / BENCHMARK_TICKS_PER_US;
+    }
+
+    //CRC-16 (CCITT) of the framebuffer, continuing from crc
+    uint16_t frameCrc(uint16_t crc) {
+      const byte* data = (const byte*)leds;
+      for (unsigned int i = 0; i < sizeof(leds); i++) {
+        crc ^= uint16_t(data[i]) << 8;
+        for (int bit = 0; bit < 8; bit++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+      return crc;
+    }
+
+    //insertion sort of the samples, used to find percentiles
+    void sort() {
+      for (int i = 1; i < FRAMES; i++) {
+        unsigned int v = samples[i];
+        int j = i - 1;
+        while (j >= 0 && samples[j] > v) {
+          samples[j + 1] = samples[j];
+          j--;
+        }
+        samples[j + 1] = v;
+      }
+    }
+};
+
+PatternBenchmark benchmark = PatternBenchmark();
@@ -0,0 +1,124 @@
+/*
+ * Drawing on the tree as a cylinder. Rows run around the tree and wrap, heights run up it and are clipped.
+ * The first led and direction of each row are looked up once, so drawing needs no ledid() or modulo per led.
+ * Rows may be up to one turn out of range either way.
+ */
+
+/*
+ * led at height 0 of each row, and the step to the led above it, stored in flash.
+ */
+template<typename T> struct RowTables;
+template<int... I> struct RowTables<IndexList<I...> > {
+  static const int16_t bottom[];
+  static const int8_t up[];
+};
+template<int... I> const int16_t RowTables<IndexList<I...> >::bottom[] PROGMEM = { ledid_calc(I, 0)... };
+template<int... I> const int8_t RowTables<IndexList<I...> >::up[] PROGMEM = { ledid_calc(I, 1) - ledid_calc(I, 0)... };
+
+typedef RowTables<MakeIndexList<ROWS>::type> rowtables;
+
+//share of a point given to a led, from the point's closeness to it in each direction, 0-255
+#define POINT_WEIGHT(a, b) byte((int(a) * (b) + (a) + (b)) >> 8)
+
+/*
+ * Draws into a led buffer. If given DirtyBlocks, marks every led drawn.
+ */
+class Canvas {
+
+    CRGB* buffer;
+    DirtyBlocks* dirty;
+
+  public:
+    Canvas(CRGB ledbuffer[], DirtyBlocks* dirtyblocks = NULL) {
+      buffer = ledbuffer;
+      dirty = dirtyblocks;
+    }
+
+    //brings a row up to one turn out of range back onto the tree
+    static int wrap(int row) {
+      if(row < 0) return row + ROWS;
+      if(row >= ROWS) return row - ROWS;
+      return row;
+    }
+
+    //led at height 0 of a row on the tree, and the step from a led to the one above it
+    CRGB* bottom(int row) {
+      return buffer + pgm_read_word(&rowtables::bottom[row]);
+    }
+    static int up(int row) {
+      return int8_t(pgm_read_byte(&rowtables::up[row]));
+    }
+
+    //led at a row and height, which must be on the tree
+    CRGB& at(int row, int height) {
+      return bottom(row)[up(row) * height];
+    }
+
+    void set(int row, int height, CRGB colour) {
+      if(height < 0 || height >= LEDS_PER_ROW) return;
+      CRGB* led = &at(wrap(row), height);
+      *led = colour;
+      touched(led, led);
+    }
+
+    //line around the tree at a height, from row for length rows
+    void hspan(int row, int height, int length, CRGB colour) {
+      if(height < 0 || height >= LEDS_PER_ROW || length <= 0) return;
+      if(length > ROWS) length = ROWS;
+      row = wrap(row);
+      for(int i = 0; i < length; i++) {
+        CRGB* led = &at(row, height);
+        *led = colour;
+        touched(led, led);
+        if(++row == ROWS) row = 0;
+      }
+    }
+
+    void ring(int height, CRGB colour) {
+      hspan(0, height, ROWS, colour);
+    }
+
+    //adds a point positioned in 1/256ths of a row and of a led, spread over the leds it overlaps
+    void point(int row8, int height8, CRGB colour) {
+      int row = row8 >> 8;
+      int height = height8 >> 8;
+      byte right = row8 & 255;
+      byte above = height8 & 255;
+      byte left = 255 - right;
+      byte below = 255 - above;
+      addScaled(row, height, colour, POINT_WEIGHT(left, below));
+      addScaled(row + 1, height, colour, POINT_WEIGHT(right, below));
+      addScaled(row, height + 1, colour, POINT_WEIGHT(left, above));
+      addScaled(row + 1, height + 1, colour, POINT_WEIGHT(right, above));
+    }
+
+    //adds a point to a line of leds, such as a row drawn for Pattern::tileRows(), positioned in 1/256ths of a led.
+    //Positions past the end of the line wrap round to its start.
+    static void linePoint(CRGB line[], int length, long position8, CRGB colour) {
+      int led = position8 >> 8;
+      byte fraction = position8 & 255;
+      if(led >= length) led -= length;
+      line[led] += CRGB(colour).nscale8(255 - fraction);
+      if(fraction == 0) return;
+      if(++led == length) led = 0;
+      line[led] += colour.nscale8(fraction);
+    }
+
+  private:
+    //adds to a led, saturating
+    void add(int row, int height, CRGB colour) {
+      if(height < 0 || height >= LEDS_PER_ROW) return;
+      CRGB* led = &at(wrap(row), height);
+      *led += colour;
+      touched(led, led);
+    }
+
+    void addScaled(int row, int height, CRGB colour, byte weight) {
+      if(weight == 0) return;
+      add(row, height, colour.nscale8(weight));
+    }
+
+    void touched(CRGB* first, CRGB* last) {
+      if(dirty) dirty->mark(first - buffer, last - buffer);
+    }
+};
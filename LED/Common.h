@@ -21,12 +21,21 @@
 
 #define NUM_LEDS         (NUM_LEDS_TREE+NUM_LEDS_STAR)
 
+//number of data pins the leds are split across. Each drives an equal group of rows, the last also drives the star.
+//Every group is wired starting at the bottom of its first row. Pins are listed in LedOutputs.h
+#define LED_OUTPUTS       1
+#define ROWS_PER_OUTPUT  (ROWS/LED_OUTPUTS)
+static_assert(ROWS % LED_OUTPUTS == 0, "ROWS must divide evenly between LED_OUTPUTS");
+
 //The main framebuffer. Managed by PatternManager
 CRGB leds[NUM_LEDS];
 
 //global framenumber
 long framenumber = 0;
 
+//Target time for a frame, 30 frames/sec. Patterns that move by time use it to keep their original speed.
+#define FRAME_MS 33
+
 /*
  * WaitFor(int) starts a timer. wait() returns false until the specified number of milliseconds expires.
  */
@@ -50,41 +59,108 @@ class WaitFor {
 };
 
 /*
- * SlidingWindow(int) maintains a sliding window of defined size. push(int) adds a value. getVal(0..n) gets a value from the window.
+ * SlidingWindow<n> maintains a sliding window of n values, stored inline. push(int) adds a value. getVal(0..n) gets a value from the window.
  */
-class SlidingWindow {
+template<int SIZE> class SlidingWindow {
 
-  int *window;
-  int windowsize;
+  int window[SIZE];
   int nextposition;
   
   public:
-    SlidingWindow(int s) {
-      windowsize = s;
-      window = new int[windowsize];
+    SlidingWindow() {
+      for(int i=0; i<SIZE; i++) window[i]=0;
       nextposition = 0;
     }
-    ~SlidingWindow() {
-      delete [] window;
-    }
 
     void push(int i) {
       window[nextposition]=i;
       nextposition ++;
-      if(nextposition==windowsize) nextposition=0;
+      if(nextposition==SIZE) nextposition=0;
     }
 
     int getVal(int pos) {
       pos+=nextposition;
-      if(pos>=windowsize) pos -= windowsize;
-      if(pos<0 || pos>=windowsize) pos = pos % windowsize;
+      if(pos>=SIZE) pos -= SIZE;
+      if(pos<0 || pos>=SIZE) pos = pos % SIZE;
       return window[pos];
     }
 
 };
 
+/*
+ * DirtyBlocks records which blocks of leds have been written to. mark(int) flags the block containing a led.
+ * Blocks not marked are known to be black, so can be skipped when fading and mixing buffers.
+ */
+#define DIRTY_BLOCK_SIZE 8
+#define DIRTY_BLOCKS     ((NUM_LEDS + DIRTY_BLOCK_SIZE - 1) / DIRTY_BLOCK_SIZE)
+
+class DirtyBlocks {
+
+  byte blocks[(DIRTY_BLOCKS + 7) / 8];
+
+  public:
+    DirtyBlocks() {
+      clear();
+    }
+
+    void clear() {
+      memset(blocks, 0, sizeof(blocks));
+    }
+
+    void mark(int led) {
+      int block = led / DIRTY_BLOCK_SIZE;
+      blocks[block >> 3] |= 1 << (block & 7);
+    }
+
+    //marks leds first..last inclusive
+    void mark(int first, int last) {
+      for(int block = first / DIRTY_BLOCK_SIZE; block <= last / DIRTY_BLOCK_SIZE; block++)
+        blocks[block >> 3] |= 1 << (block & 7);
+    }
+
+    bool isDirty(int block) {
+      return blocks[block >> 3] & (1 << (block & 7));
+    }
+};
+
 //Copy of the arduino map function, using int rather than long.
 int map16(int x, int in_min, int in_max, int out_min, int out_max)
 {
   return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 }
+
+/*
+ * Random numbers and time for patterns, which get them through Pattern::random8(), random() and millis().
+ * A run can be repeated exactly: seed() restarts the random sequence, and setFrameTime() makes time advance
+ * a fixed step each frame instead of following the real clock.
+ */
+class PatternEnvironment {
+
+  uint16_t state = 1337;
+  //milliseconds per frame, 0 to use the real clock
+  int frametime = 0;
+
+  public:
+    PatternEnvironment() {
+    }
+
+    void seed(uint16_t s) {
+      state = s;
+    }
+
+    void setFrameTime(int ms) {
+      frametime = ms;
+    }
+
+    //the same generator as FastLED's random16()
+    uint16_t random16() {
+      state = state * 2053 + 13849;
+      return state;
+    }
+
+    unsigned long millis() {
+      return frametime ? (unsigned long)framenumber * frametime : ::millis();
+    }
+};
+
+PatternEnvironment patternenvironment = PatternEnvironment();
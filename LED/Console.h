@@ -0,0 +1,114 @@
+/*
+ * Reads commands from Serial, one per line, without blocking the frame.
+ *  T                                          binary telemetry dump, see Tools/telemetry.py
+ *  levels                                     prints the level config
+ *  levels <n>                                 sets the number of levels
+ *  level <i> <threshold> <neg> <pos> <durneg> <durpos>
+ *                                             sets the boundary between level i and i+1
+ *  save                                       stores the level config in EEPROM
+ *  defaults                                   restores the default level config
+ * Level changes take effect immediately, and are only kept over a reboot once saved.
+ */
+#define CONSOLE_LINE_LENGTH 48
+
+class Console {
+
+  char line[CONSOLE_LINE_LENGTH];
+  byte length = 0;
+  //line was too long, ignore it
+  bool overflow = false;
+
+  public: Console() {
+  }
+
+  //handles any complete lines waiting on Serial
+  void update() {
+    while(Serial.available()) {
+      char c = Serial.read();
+      if(c == '\r') continue;
+      if(c != '\n') {
+        if(length < CONSOLE_LINE_LENGTH-1) line[length++] = c;
+        else overflow = true;
+        continue;
+      }
+      line[length] = 0;
+      if(overflow) Serial.println(F("error: line too long"));
+      else if(length > 0) execute();
+      length = 0;
+      overflow = false;
+    }
+  }
+
+  private:
+
+  void execute() {
+    long args[6];
+    char *cursor = line;
+    char *command = nextToken(cursor);
+    int count = 0;
+    char *token;
+    while(count < 6 && (token = nextToken(cursor))) {
+      char *end;
+      args[count++] = strtol(token, &end, 10);
+      if(*end) {
+        Serial.println(F("error: expected a number"));
+        return;
+      }
+    }
+    if(nextToken(cursor)) {
+      Serial.println(F("error: too many arguments"));
+      return;
+    }
+
+    LevelConfig config = soundlevel.getConfig();
+    if(!strcmp(command, "T") && count == 0) {
+      telemetry.dump();
+    } else if(!strcmp(command, "levels") && count == 0) {
+      config.print();
+    } else if(!strcmp(command, "levels") && count == 1) {
+      config.setLevels(constrain(args[0], 0, 255));
+      apply(config);
+    } else if(!strcmp(command, "level") && count == 6) {
+      if(args[0] < 0 || args[0] >= config.levels-1) {
+        Serial.println(F("error: no such level boundary"));
+        return;
+      }
+      config.setBoundary(args[0], constrain(args[1], -32768, 32767),
+          constrain(args[2], 0, 255), constrain(args[3], 0, 255),
+          constrain(args[4], 0, 255), constrain(args[5], 0, 255));
+      apply(config);
+    } else if(!strcmp(command, "save") && count == 0) {
+      config.save();
+      Serial.println(F("saved"));
+    } else if(!strcmp(command, "defaults") && count == 0) {
+      config.setDefaults();
+      apply(config);
+    } else {
+      Serial.println(F("error: unknown command"));
+    }
+  }
+
+  //use a changed config, reporting why if it isn't valid
+  void apply(const LevelConfig& config) {
+    const __FlashStringHelper* error = soundlevel.setConfig(config);
+    if(error) {
+      Serial.print(F("error: "));
+      Serial.println(error);
+    } else {
+      soundlevel.getConfig().print();
+    }
+  }
+
+  //splits off the next space seperated token, NULL at the end of the line
+  char* nextToken(char*& cursor) {
+    while(*cursor == ' ') cursor++;
+    if(!*cursor) return NULL;
+    char *token = cursor;
+    while(*cursor && *cursor != ' ') cursor++;
+    if(*cursor) *cursor++ = 0;
+    return token;
+  }
+
+};
+
+Console console = Console();
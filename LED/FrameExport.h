@@ -0,0 +1,49 @@
+/*
+ * Streams every rendered frame over Serial, so patterns can be previewed and reviewed without the tree.
+ * Enabled by FRAME_EXPORT in LED.ino. Tools/frames.py captures the stream and writes image sequences.
+ * Test/Render.cpp produces the same stream on a PC, which is quicker for reviewing a long run.
+ *
+ * Layout record, sent once at startup:
+ *  'L' 'E' 'D', version, rows, leds per row, rows per output, star points, star point leds, star core leds,
+ *  star center leds
+ * Frame record, sent every frame:
+ *  'F' 'R', frame number (4 bytes, little endian), then r, g, b of every led in framebuffer order
+ * Frames are the patterns and overlays as rendered, before the output stage applies gamma and brightness.
+ */
+
+//fast enough to send a frame in about half the frame time
+#define FRAME_EXPORT_BAUD 1000000
+
+class FrameExport {
+
+    //format of the records, increment if it changes
+    static const byte VERSION = 1;
+
+  public:
+    FrameExport() {
+    }
+
+    //describes the led layout, so frames can be drawn
+    void setup() {
+      Serial.write('L');
+      Serial.write('E');
+      Serial.write('D');
+      Serial.write(VERSION);
+      Serial.write(byte(ROWS));
+      Serial.write(byte(LEDS_PER_ROW));
+      Serial.write(byte(ROWS_PER_OUTPUT));
+      Serial.write(byte(STAR_POINTS));
+      Serial.write(byte(STAR_POINT_LEDS));
+      Serial.write(byte(STAR_CORE_LEDS));
+      Serial.write(byte(STAR_CENTER_LEDS));
+    }
+
+    void send(const CRGB ledbuffer[]) {
+      Serial.write('F');
+      Serial.write('R');
+      for(int i = 0; i < 4; i++) Serial.write(byte(framenumber >> (8 * i)));
+      Serial.write((const uint8_t*)ledbuffer, NUM_LEDS * sizeof(CRGB));
+    }
+};
+
+FrameExport frameexport = FrameExport();
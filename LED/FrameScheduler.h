@@ -0,0 +1,107 @@
+/*
+ * Paces the main loop. Frames are due on fixed deadlines FRAME_MS apart, rather than FRAME_MS after the last frame
+ * ended, so a slow frame is made up by the frames after it instead of slowing everything down.
+ * Every frame is rendered, so patterns timed by the clock keep their speed under load. When the loop is running late,
+ * FastLED.show(), which takes a fixed time for every frame, is skipped to catch up. No more than MAX_DROPPED_FRAMES in
+ * a row are skipped, so the tree keeps moving. If the loop still falls more than MAX_LAG_MS behind, it gives up catching up.
+ * Counts the frames shown each second, the effective frame rate.
+ */
+
+//consecutive frames that may be rendered without being shown
+#define MAX_DROPPED_FRAMES 2
+//how far a frame may end after its deadline before shows are skipped to catch up
+#define LATE_ALLOWANCE_MS  (FRAME_MS / 2)
+//how far behind the loop may fall before the deadlines are moved instead
+#define MAX_LAG_MS         (FRAME_MS * 4)
+
+class FrameScheduler {
+
+    //when the current frame is due to end
+    unsigned long deadline;
+    //average FastLED.show() time, in microseconds
+    unsigned long showtime;
+    unsigned long showstart;
+    //frames in a row that were not shown
+    byte dropped;
+    //totals since startup
+    unsigned int drops;
+    unsigned int resyncs;
+    //frames shown in the current second, and in the last whole second
+    unsigned long secondstart;
+    byte shown;
+    byte fps;
+
+  public:
+    FrameScheduler() {
+      showtime = showTimeUs(false);
+      dropped = 0;
+      drops = 0;
+      resyncs = 0;
+      shown = 0;
+      fps = 0;
+    }
+
+    void setup() {
+      deadline = millis() + FRAME_MS;
+      secondstart = millis();
+    }
+
+    //returns true if the frame should be shown, and starts timing the show
+    bool startShow() {
+      long late = long(millis() + showtime / 1000 - deadline);
+      if (late > LATE_ALLOWANCE_MS && dropped < MAX_DROPPED_FRAMES) {
+        dropped++;
+        drops++;
+        return false;
+      }
+      dropped = 0;
+      shown++;
+      showstart = micros();
+      return true;
+    }
+
+    void endShow() {
+      showtime += (long(micros() - showstart) - long(showtime)) / 8;
+    }
+
+    //waits until the frame is due to end, and sets the next deadline. Returns false if the loop had fallen too far behind.
+    bool endFrame() {
+      bool caughtup = true;
+      if (long(millis() - deadline) > MAX_LAG_MS) {
+        deadline = millis();
+        resyncs++;
+        caughtup = false;
+      }
+      while (long(millis() - deadline) < 0) {
+      }
+      deadline += FRAME_MS;
+      if (millis() - secondstart >= 1000) {
+        secondstart += 1000;
+        fps = shown;
+        shown = 0;
+      }
+      return caughtup;
+    }
+
+    //milliseconds until the current frame is due to end, negative if late
+    long timeRemaining() {
+      return long(deadline - millis());
+    }
+
+    //frames shown in the last second
+    byte getFps() {
+      return fps;
+    }
+
+    //frames rendered but not shown
+    unsigned int getDrops() {
+      return drops;
+    }
+
+    //times the loop fell more than MAX_LAG_MS behind
+    unsigned int getResyncs() {
+      return resyncs;
+    }
+};
+
+FrameScheduler framescheduler = FrameScheduler();
@@ -1,5 +1,13 @@
 #include <FastLED.h>
 #include "PatternManager.h"
+#include "LedOutputs.h"
+#include "OutputStage.h"
+#include "Benchmark.h"
+#include "FrameScheduler.h"
+#include "SensorLink.h"
+#include "Telemetry.h"
+#include "Console.h"
+#include "FrameExport.h"
 
 //Limits maximum power draw to the specified number of amps.
 float MAX_POWER_AMPS = 0;
@@ -9,30 +17,36 @@ float MAX_POWER_AMPS = 0;
 //WARNING: this will disable MAX_POWER_AMPS limit and run leds as hard as possible.
 #define LOADTEST false
 
-#define LED_DATA_DPIN 2
-#define FRAME_SIGNAL_DPIN 3
+//Runs every pattern headless and reports its cost over Serial, instead of running the tree.
+#define BENCHMARK false
+
+//Sends every frame over Serial, at FRAME_EXPORT_BAUD, for Tools/frames.py to turn into images.
+//Test/Render.cpp turns it on to render the show on a PC.
+#ifndef FRAME_EXPORT
+#define FRAME_EXPORT false
+#endif
 
 
 void setup() {
   //Debugging
-  Serial.begin(9600);
+  Serial.begin(FRAME_EXPORT ? FRAME_EXPORT_BAUD : 9600);
+  if(FRAME_EXPORT) frameexport.setup();
   //Initialise FastLED library
-  FastLED.addLeds<NEOPIXEL, LED_DATA_DPIN>(leds, NUM_LEDS);
+  LedOutputs<LED_OUTPUTS>::add();
+  //brightness and dithering are done by outputstage
+  FastLED.setBrightness(255);
+  FastLED.setDither(DISABLE_DITHER);
   if(!LOADTEST)
     if(MAX_POWER_AMPS>0)
-      FastLED.setMaxPowerInVoltsAndMilliamps(5,MAX_POWER_AMPS*1000);
+      outputstage.setPowerLimit(MAX_POWER_AMPS*1000);
   //Comms from Sensor board
-  if(SOUND_SENSOR || LIGHT_SENSOR) Serial3.begin(9600);
-  //Frame signal to Sensor Board
-  pinMode(FRAME_SIGNAL_DPIN, OUTPUT);
-  //Reset frame signal and clear serial buffer
-  digitalWrite(FRAME_SIGNAL_DPIN, LOW);
-  delay(5);
-  if(SOUND_SENSOR || LIGHT_SENSOR) while(Serial3.available()) Serial3.read();
+  if(SOUND_SENSOR || LIGHT_SENSOR) sensorlink.setup();
   //Clear led buffer
   for(int i=0; i<NUM_LEDS; i++) {
     leds[i]=CRGB::Black;
   }
+  //Level thresholds, from EEPROM
+  if(SOUND_SENSOR) soundlevel.setup();
   //Setup managers
   //Determines which set of patterns to display based on audio levels
   levelmanager.setup();
@@ -42,12 +56,14 @@ void setup() {
   if(SOUND_SENSOR) soundlevelstatus.setup();
   //debug pattern, flickers indicating program is running
   framestatus.setup();
+  //first frame deadline
+  framescheduler.setup();
 }
 
 //timer that tracks how long frame calculations take
 long frametime=0;
 //Target time for a frame
-const int FRAME_TIME=33;  // 30 frames/sec
+const int FRAME_TIME=FRAME_MS;
 //tracks recent sound level
 int lastlevel = -1;
 
@@ -65,7 +81,13 @@ void loop() {
   //Start a timer
   WaitFor t = WaitFor(FRAME_TIME);
 
+  if(BENCHMARK) {
+    if(framenumber==1) benchmark.run(FRAME_TIME);
+    return;
+  }
+
   if(LOADTEST) {
+    static Blank blank = Blank();
     if(framenumber==1) loadtest.setup();
     if(!Serial.available()) {
       loadtest.update(leds);
@@ -74,34 +96,37 @@ void loop() {
       blank.update(leds);
     }
     if(framenumber%30==0) {
-      Serial.println("Power: " + String(0.001 * calculate_unscaled_power_mW(leds, NUM_LEDS)) + "W");
+      //estimated current of each power segment
+      long total = 0;
+      Serial.print(F("Current:"));
+      for(int segment = 0; segment < POWER_SEGMENTS; segment++) {
+        long segmentcurrent = estimateMilliamps(leds, segmentstart(segment), segmentstart(segment + 1));
+        total += segmentcurrent;
+        Serial.print(' ');
+        Serial.print(0.001 * segmentcurrent);
+      }
+      Serial.println("A Power: " + String(0.005 * total) + "W");
       frametime = 0;
     }
     FastLED.show();
     while(t.wait());
     return;
   }
-  
-  if(SOUND_SENSOR || LIGHT_SENSOR) {
-    //Signal Sensor board to send data, and wait for 2 bytes
-    while(Serial3.available()) Serial3.read();
-    digitalWrite(FRAME_SIGNAL_DPIN, HIGH);
-    while(Serial3.available()<3) continue;
-    while(Serial3.available() && Serial3.read()!=42) continue;
-    while(Serial3.available()<2) continue;
-    digitalWrite(FRAME_SIGNAL_DPIN, LOW);
-    //Read data and split into 
-    lightlevel = Serial3.read();
-    //Serial.print(lightlevel);
-    //Serial.print(" ");
-    audiolevel = (lightlevel & 3) << 8;
-    lightlevel = lightlevel >> 2;
-    audiolevel = audiolevel | Serial3.read();
+
+  //handle debugging commands, including telemetry requests. When capturing or replaying, Serial carries the sensor
+  //log instead, and a command's reply could be mistaken for log records.
+  if(SENSOR_SOURCE == SENSOR_LIVE) console.update();
+  telemetry.startFrame();
+
+  //collect the reading requested at the end of the last frame. If there isn't one, keep the last values.
+  if((SOUND_SENSOR || LIGHT_SENSOR) && sensorlink.poll()) {
+    lightlevel = sensorlink.getLightLevel();
+    audiolevel = sensorlink.getAudioLevel();
     if(SOUND_SENSOR) {
       //update sound level model
       soundlevel.update(audiolevel);
-      int level = soundlevel.getLevel();
-    
+      beatdetector.update(audiolevel);
+
       if(lastlevel != soundlevel.getLevel()) {
         //if sound level has changed inform levelmanager
         lastlevel = soundlevel.getLevel();
@@ -109,11 +134,13 @@ void loop() {
       }
     }
   }
+  telemetry.endStage(STAGES::SENSOR);
 
   frametime += t.timeRemaining();
   //generate new frame data
   levelmanager.update();
   frametime -= t.timeRemaining();
+  telemetry.endStage(STAGES::PATTERN);
 
   //small indicator of sound level and frame status for testing
   if(SOUND_SENSOR && DEBUG) soundlevelstatus.update();
@@ -122,16 +149,30 @@ void loop() {
   //peak indicator
   if(SOUND_SENSOR && !DEMO) soundpeak.update();
 
+  if(FRAME_EXPORT) frameexport.send(leds);
+  telemetry.endStage(STAGES::OVERLAY);
   //set overall brightness baseed on ambient light levels
   if(LIGHT_SENSOR && !DEMO)
-    FastLED.setBrightness(map(constrain(lightlevel, 5, 40), 1, 40, 0, 255));
-  //FastLED.setBrightness(64);
-  //Display pattern
-  FastLED.show();
-  //Send alert if calculations took too long
-  if(t.timeRemaining()<0)
-    Serial.println("CYCLE TOOK " + String(-t.timeRemaining()) + "ms TOO LONG");
+    outputstage.setBrightness(map(constrain(lightlevel, 5, 40), 1, 40, 0, 255));
+  //outputstage.setBrightness(64);
+  //gamma correct, scale and dither the frame
+  outputstage.apply(leds);
+  telemetry.endStage(STAGES::OUTPUTSTAGE);
+  //Display pattern, unless running late. The frame is still rendered, so patterns keep their speed.
+  if(framescheduler.startShow()) {
+    FastLED.show();
+    framescheduler.endShow();
+  }
+  telemetry.endStage(STAGES::SHOW);
+  //ask for the next frame's reading, it arrives while we wait out this frame
+  if(SOUND_SENSOR || LIGHT_SENSOR) sensorlink.request();
+  telemetry.endFrame(FRAME_TIME);
+  //Send alert if frames are taking so long that skipping shows can't catch up
+  long late = -framescheduler.timeRemaining();
   //Wait out the rest of the frame
-  while(t.wait()) {
+  if(!framescheduler.endFrame()) {
+    Serial.print(F("FELL "));
+    Serial.print(late);
+    Serial.println(F("ms BEHIND"));
   }
 }
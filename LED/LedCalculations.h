@@ -2,42 +2,101 @@
  * Utility functions for calculating led positions
  */
 
-//returns the ID of the led on the given row, at the give height.
-//Will "wrap" out of range leds between rows and heights
-int ledid(int row, int height) {
+//compile time version of the led mapping. Within each output, even rows run bottom to top, odd rows top to bottom.
+constexpr bool ledrow_upwards(int row) {
+  return row % ROWS_PER_OUTPUT % 2 == 0;
+}
+constexpr int ledid_calc(int row, int height) {
+  return LEDS_PER_ROW * row + (ledrow_upwards(row) ? height : LEDS_PER_ROW - 1 - height);
+}
+constexpr int ledrow_calc(int id) {
+  return id / LEDS_PER_ROW;
+}
+constexpr int ledheight_calc(int id) {
+  return ledrow_upwards(ledrow_calc(id)) ? id % LEDS_PER_ROW : LEDS_PER_ROW - 1 - id % LEDS_PER_ROW;
+}
+
+//first led of an output
+constexpr int outputstart(int output) {
+  return output * ROWS_PER_OUTPUT * LEDS_PER_ROW;
+}
+//number of leds on an output, the star is on the last output
+constexpr int outputlength(int output) {
+  return ROWS_PER_OUTPUT * LEDS_PER_ROW + (output == LED_OUTPUTS - 1 ? NUM_LEDS_STAR : 0);
+}
+
+//generates the list 0..N-1 at compile time, used to fill lookup tables
+template<int... I> struct IndexList {};
+template<int N, int... I> struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+template<int... I> struct MakeIndexList<0, I...> {
+  typedef IndexList<I...> type;
+};
+
+/*
+ * Lookup tables for the tree, stored in flash.
+ * id is indexed by row*LEDS_PER_ROW+height, row and height are indexed by led id.
+ */
+template<typename T> struct LedTables;
+template<int... I> struct LedTables<IndexList<I...> > {
+  static const uint16_t id[];
+  static const byte row[];
+  static const byte height[];
+};
+template<int... I> const uint16_t LedTables<IndexList<I...> >::id[] PROGMEM = { ledid_calc(I / LEDS_PER_ROW, I % LEDS_PER_ROW)... };
+template<int... I> const byte LedTables<IndexList<I...> >::row[] PROGMEM = { ledrow_calc(I)... };
+template<int... I> const byte LedTables<IndexList<I...> >::height[] PROGMEM = { ledheight_calc(I)... };
+
+typedef LedTables<MakeIndexList<NUM_LEDS_TREE>::type> ledtables;
+
+//slow path of ledid(), wraps any row or height
+int ledid_wrap(int row, int height) {
   while(row<0) row+=ROWS;
   if(row>=int(ROWS))
     row = row % int(ROWS);
-  int r = LEDS_PER_ROW * row;
   while(height<0) height+=LEDS_PER_ROW;
   if(height >=int(LEDS_PER_ROW))
     height = height % int(LEDS_PER_ROW);
-  if(row%2==0) {
-    r+=height;
-  } else {
-    r+=LEDS_PER_ROW - 1 - height;
-  }
-  return r;
+  return pgm_read_word(&ledtables::id[row * LEDS_PER_ROW + height]);
+}
+
+//returns the ID of the led on the given row, at the give height.
+//Will "wrap" out of range leds between rows and heights
+int ledid(int row, int height) {
+  //fast path, values up to one wrap out of range are corrected without division
+  if(row<0) row+=ROWS;
+  else if(row>=int(ROWS)) row-=ROWS;
+  if(height<0) height+=LEDS_PER_ROW;
+  else if(height>=int(LEDS_PER_ROW)) height-=LEDS_PER_ROW;
+  if(row<0 || row>=int(ROWS) || height<0 || height>=int(LEDS_PER_ROW))
+    return ledid_wrap(row, height);
+  return pgm_read_word(&ledtables::id[row * LEDS_PER_ROW + height]);
 }
 
 
 //returns the ID of the led on the given row, at the give height.
 //Will "wrap" out of rows, but constrains height to be within range
 int ledidC(int row, int height) {
-  while(row<0) row+=ROWS;
-  if(row>=int(ROWS))
-    row = row % int(ROWS);
-  int r = LEDS_PER_ROW * row;
+  if(row<0) row+=ROWS;
+  else if(row>=int(ROWS)) row-=ROWS;
+  if(row<0 || row>=int(ROWS))
+    return ledid_wrap(row, constrain(height, 0, LEDS_PER_ROW-1));
   height = constrain(height, 0, LEDS_PER_ROW-1);
-  if(row%2==0) {
-    r+=height;
-  } else {
-    r+=LEDS_PER_ROW - 1 - height;
-  }
-  return r;
+  return pgm_read_word(&ledtables::id[row * LEDS_PER_ROW + height]);
+}
+
+//returns the row of the given tree led
+int ledrow(int id) {
+  return pgm_read_byte(&ledtables::row[id]);
+}
+
+//returns the height of the given tree led
+int ledheight(int id) {
+  return pgm_read_byte(&ledtables::height[id]);
 }
 
 
+//the star follows the tree rows on the last output, so its leds are at the end of the framebuffer
+static_assert(outputstart(LED_OUTPUTS - 1) + outputlength(LED_OUTPUTS - 1) == NUM_LEDS, "star must end the last output");
 int starid(int section, int point, int pos) {
   if(section==0)
     return NUM_LEDS-2+pos;
@@ -0,0 +1,31 @@
+/*
+ * Registers each LED_OUTPUTS data pin with FastLED, each driving its own part of the framebuffer.
+ * See outputstart() and outputlength() for which leds go to which pin.
+ */
+
+//data pin for each output, in row order. Must list LED_OUTPUTS pins.
+constexpr byte LED_DATA_DPINS[] = {2, 4, 5, 6, 7, 8, 9, 10};
+static_assert(sizeof(LED_DATA_DPINS) >= LED_OUTPUTS, "LED_DATA_DPINS must list a pin for every output");
+
+//FastLED needs each pin at compile time, so outputs are added by recursion over the pin list
+template<int N> struct LedOutputs {
+  static void add() {
+    LedOutputs<N - 1>::add();
+    FastLED.addLeds<NEOPIXEL, LED_DATA_DPINS[N - 1]>(leds + outputstart(N - 1), outputlength(N - 1));
+  }
+};
+template<> struct LedOutputs<0> {
+  static void add() {
+  }
+};
+
+//time to send a ws2812b led (24 bits at 1.25us), and the reset (latch) gap after each output
+#define LED_TIME_US    30L
+#define LATCH_TIME_US  50L
+
+//Estimated FastLED.show() time. The AVR sends outputs one after another, so splitting doesn't change the
+//total; parallel is the estimate for boards FastLED can drive several pins at once on, with the same split.
+constexpr long showTimeUs(bool parallel) {
+  return parallel ? outputlength(LED_OUTPUTS - 1) * LED_TIME_US + LATCH_TIME_US
+                  : NUM_LEDS * LED_TIME_US + LED_OUTPUTS * LATCH_TIME_US;
+}
@@ -0,0 +1,158 @@
+/*
+ * Final stage before FastLED.show(): gamma correction and overall brightness, with temporal dithering so dim
+ * colours fade smoothly instead of banding. Applied in place over the framebuffer, after patterns and overlays.
+ * The same pass estimates the current each power segment draws, and limits any segment near its fuse rating.
+ */
+
+//the leds are powered by POWER_SEGMENTS separately fused runs, each an equal group of rows. The star is on the last.
+#define POWER_SEGMENTS     4
+#define ROWS_PER_SEGMENT   (ROWS/POWER_SEGMENTS)
+static_assert(ROWS % POWER_SEGMENTS == 0, "ROWS must divide evenly between POWER_SEGMENTS");
+//fuse rating of each segment
+#define SEGMENT_LIMIT_MA   10000L
+//current a ws2812b draws for each channel at full brightness, and when dark. The same model FastLED uses.
+#define RED_MA    16
+#define GREEN_MA  11
+#define BLUE_MA   15
+#define DARK_MA    1
+
+//first led of a power segment, segmentstart(POWER_SEGMENTS) is the end of the framebuffer
+constexpr int segmentstart(int segment) {
+  return segment == POWER_SEGMENTS ? NUM_LEDS : segment * ROWS_PER_SEGMENT * LEDS_PER_ROW;
+}
+
+//estimated current for a set of channel totals, in mA
+long estimateMilliamps(unsigned long red, unsigned long green, unsigned long blue, int count) {
+  return (red * RED_MA + green * GREEN_MA + blue * BLUE_MA) / 255 + long(count) * DARK_MA;
+}
+
+//estimated current for some leds, in mA
+long estimateMilliamps(const CRGB ledbuffer[], int first, int last) {
+  unsigned long red = 0, green = 0, blue = 0;
+  for(int i = first; i < last; i++) {
+    red += ledbuffer[i].r;
+    green += ledbuffer[i].g;
+    blue += ledbuffer[i].b;
+  }
+  return estimateMilliamps(red, green, blue, last - first);
+}
+
+//Soft limit: no change up to 3/4 of the limit, above that current is compressed so it approaches but never
+//reaches the limit. Returns the scale (of 256) to apply to the leds, dark current can't be scaled.
+int softLimitScale(long current, long limit, int count) {
+  long knee = limit * 3 / 4;
+  if(current <= knee) return 256;
+  long headroom = limit - knee;
+  long excess = current - knee;
+  long target = knee + headroom * excess / (excess + headroom);
+  long dark = long(count) * DARK_MA;
+  if(target <= dark) return 0;
+  return (target - dark) * 256 / (current - dark);
+}
+
+//gamma 2.2 curve, 0..255 in 1/256ths of an output level
+const uint16_t gamma16[256] PROGMEM = {
+      0,     0,     2,     4,     7,    11,    17,    24,    32,    42,    53,    65,    78,    94,   110,   128,
+    148,   169,   191,   216,   241,   269,   298,   328,   360,   394,   430,   467,   506,   547,   589,   633,
+    679,   726,   776,   827,   880,   934,   991,  1049,  1109,  1171,  1235,  1300,  1368,  1437,  1508,  1581,
+   1656,  1733,  1812,  1893,  1975,  2060,  2146,  2235,  2325,  2417,  2512,  2608,  2706,  2806,  2908,  3013,
+   3119,  3227,  3337,  3450,  3564,  3680,  3798,  3919,  4041,  4166,  4292,  4421,  4552,  4685,  4819,  4956,
+   5096,  5237,  5380,  5525,  5673,  5823,  5974,  6128,  6284,  6442,  6603,  6765,  6930,  7097,  7266,  7437,
+   7610,  7786,  7963,  8143,  8325,  8509,  8696,  8885,  9075,  9268,  9464,  9661,  9861, 10063, 10267, 10474,
+  10682, 10893, 11107, 11322, 11540, 11760, 11982, 12207, 12433, 12663, 12894, 13128, 13363, 13602, 13842, 14085,
+  14330, 14578, 14827, 15080, 15334, 15591, 15850, 16111, 16375, 16641, 16909, 17180, 17453, 17729, 18006, 18287,
+  18569, 18854, 19141, 19431, 19723, 20017, 20314, 20613, 20915, 21218, 21525, 21833, 22144, 22458, 22774, 23092,
+  23413, 23736, 24062, 24390, 24720, 25053, 25388, 25726, 26066, 26408, 26753, 27101, 27451, 27803, 28158, 28515,
+  28875, 29237, 29602, 29969, 30338, 30710, 31085, 31462, 31841, 32223, 32608, 32995, 33384, 33776, 34170, 34567,
+  34967, 35369, 35773, 36180, 36589, 37001, 37416, 37833, 38252, 38674, 39099, 39526, 39956, 40388, 40823, 41260,
+  41700, 42142, 42587, 43034, 43484, 43937, 44392, 44849, 45310, 45772, 46238, 46706, 47176, 47649, 48125, 48603,
+  49084, 49567, 50053, 50542, 51033, 51526, 52023, 52522, 53023, 53527, 54034, 54543, 55055, 55570, 56087, 56607,
+  57129, 57654, 58182, 58712, 59245, 59780, 60318, 60859, 61402, 61948, 62497, 63048, 63602, 64159, 64718, 65280
+};
+
+class OutputStage {
+
+    //gamma corrected and scaled output for each input level, in 1/256ths
+    uint16_t lut[256];
+    byte brightness;
+    bool built = false;
+    //frames since start, selects the dither threshold
+    byte frame = 0;
+    //estimated current of each segment in the last frame, after limiting, in mA
+    long current[POWER_SEGMENTS];
+    //limit for all segments together, in mA, or 0 for none
+    long totallimit = 0;
+
+  public:
+    OutputStage() {
+    }
+
+    //rebuilds the lookup table, only if brightness has changed
+    void setBrightness(byte b) {
+      if(built && b == brightness) return;
+      brightness = b;
+      built = true;
+      for(int i = 0; i < 256; i++) {
+        //*257>>16 divides by 255, without a division
+        lut[i] = (uint32_t(pgm_read_word(&gamma16[i])) * b * 257) >> 16;
+      }
+    }
+
+    //limits the current drawn by all segments together, in mA. 0 for no limit beyond the segment fuses.
+    void setPowerLimit(long milliamps) {
+      totallimit = milliamps;
+    }
+
+    //converts the framebuffer to output levels. Call once per frame, after all patterns and overlays.
+    void apply(CRGB ledbuffer[]) {
+      if(!built) setBrightness(255);
+      //the fraction lost by rounding down is made up over 8 frames: the threshold steps through
+      //0..7 eighths in bit reversed order, so every level is shown for an even share of frames
+      frame++;
+      byte threshold = ((frame & 1) << 7 | (frame & 2) << 5 | (frame & 4) << 3) + 16;
+      long total = 0;
+      for(int segment = 0; segment < POWER_SEGMENTS; segment++) {
+        //output totals for the power estimate, gathered while converting
+        unsigned long red = 0, green = 0, blue = 0;
+        for(int i = segmentstart(segment); i < segmentstart(segment + 1); i++) {
+          CRGB& led = ledbuffer[i];
+          led.r = (lut[led.r] + threshold) >> 8;
+          led.g = (lut[led.g] + threshold) >> 8;
+          led.b = (lut[led.b] + threshold) >> 8;
+          red += led.r;
+          green += led.g;
+          blue += led.b;
+          //offset each led, so neighbours don't all step up on the same frame
+          threshold += 97;
+        }
+        current[segment] = estimateMilliamps(red, green, blue, segmentstart(segment + 1) - segmentstart(segment));
+        total += current[segment];
+      }
+      //the overall limit scales every segment alike
+      int totalscale = totallimit > 0 ? softLimitScale(total, totallimit, NUM_LEDS) : 256;
+      for(int segment = 0; segment < POWER_SEGMENTS; segment++) {
+        int count = segmentstart(segment + 1) - segmentstart(segment);
+        int scale = min(totalscale, softLimitScale(current[segment], SEGMENT_LIMIT_MA, count));
+        //only segments over their limit need a second pass
+        if(scale < 256) {
+          for(int i = segmentstart(segment); i < segmentstart(segment + 1); i++) {
+            ledbuffer[i].nscale8(scale);
+          }
+          current[segment] = estimateMilliamps(ledbuffer, segmentstart(segment), segmentstart(segment + 1));
+        }
+      }
+    }
+
+    //estimated current drawn by a segment in the last frame, in mA
+    long getMilliamps(int segment) {
+      return current[segment];
+    }
+
+    long getTotalMilliamps() {
+      long total = 0;
+      for(int segment = 0; segment < POWER_SEGMENTS; segment++) total += current[segment];
+      return total;
+    }
+};
+
+OutputStage outputstage = OutputStage();
@@ -0,0 +1,72 @@
+/*
+ * Storage for the patterns in use. At most two patterns run at once (current and next, while crossfading),
+ * so rather than every pattern being a global, pattern state is constructed in one of two slots when needed
+ * and destroyed when it is finished with. Each slot is sized for the largest pattern at compile time.
+ */
+
+//selects the placement new below, so we dont depend on <new>, which the AVR core may not provide
+struct ArenaTag {};
+inline void* operator new(size_t, ArenaTag, void* slot) {
+  return slot;
+}
+
+//largest size and alignment of a list of types
+template<class... T> struct Largest;
+template<class T> struct Largest<T> {
+  static constexpr size_t size = sizeof(T);
+  static constexpr size_t align = alignof(T);
+};
+template<class T, class... R> struct Largest<T, R...> {
+  static constexpr size_t size = sizeof(T) > Largest<R...>::size ? sizeof(T) : Largest<R...>::size;
+  static constexpr size_t align = alignof(T) > Largest<R...>::align ? alignof(T) : Largest<R...>::align;
+};
+
+//builds pattern T in the memory provided
+template<class T> Pattern* constructPattern(void* slot) {
+  return new(ArenaTag(), slot) T();
+}
+typedef Pattern* (*PatternFactory)(void*);
+
+//The pattern classes, in the same order as PATTERNS::PATTERN
+template<class... T> struct PatternTypes {
+  static const int count = sizeof...(T);
+  static constexpr size_t size = Largest<T...>::size;
+  static constexpr size_t align = Largest<T...>::align;
+  static const PatternFactory factories[sizeof...(T)];
+};
+template<class... T> const PatternFactory PatternTypes<T...>::factories[sizeof...(T)] PROGMEM = {&constructPattern<T>...};
+
+template<class Types> class PatternArena {
+  public:
+    //bytes reserved for each pattern, the size of the largest pattern
+    static constexpr size_t SLOT_SIZE = Types::size;
+    static const int SLOTS = 2;
+
+  private:
+    alignas(Types::align) byte slots[SLOTS][SLOT_SIZE];
+    //pattern in each slot, NULL if empty
+    Pattern* patterns[SLOTS] = {NULL, NULL};
+
+  public:
+    PatternArena() {
+    }
+
+    //destroys whatever is in the slot, and constructs pattern p in its place
+    Pattern* create(int slot, int p) {
+      destroy(slot);
+      //patterns were written as globals, and expect their members to start zeroed like any other global
+      memset(slots[slot], 0, SLOT_SIZE);
+      PatternFactory factory = (PatternFactory)pgm_read_ptr(&Types::factories[p]);
+      patterns[slot] = factory(slots[slot]);
+      return patterns[slot];
+    }
+
+    void destroy(int slot) {
+      if(patterns[slot]) patterns[slot]->~Pattern();
+      patterns[slot] = NULL;
+    }
+
+    Pattern* get(int slot) {
+      return patterns[slot];
+    }
+};
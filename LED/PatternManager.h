@@ -2,6 +2,7 @@
  * These classes manages which patterns to display, and crossfading beween them.
  */
 #include "Patterns.h"
+#include "PatternArena.h"
 #define DEMO false
 
 //Lists all available patterns
@@ -25,159 +26,260 @@ namespace PATTERNS {
     FIREWORKS,
     ALTSTRIPES,
     SWIRLPAINT,
-    TESTPATTERN
+    TESTPATTERN,
+    //number of patterns, not a pattern
+    PATTERN_COUNT
   };
 };
 
-//Initialise all patterns used
-Blank blank = Blank();
-Ornaments ornaments = Ornaments();
-Chase1 chase1 = Chase1();
-Chase2 chase2 = Chase2();
-FlashRow flashrow = FlashRow();
-FlashRing flashring = FlashRing();
-ChristmasRadio christmasradio = ChristmasRadio();
-Eye eye = Eye();
-Fire fire = Fire();
-BouncingBall bouncingball = BouncingBall();
-Loudness loudness = Loudness();
-FallingStar fallingstar = FallingStar();
-Sparkle sparkle = Sparkle();
-Wiggle wiggle = Wiggle();
-Diagonal diagonal = Diagonal();
-Fireworks fireworks = Fireworks();
-AltStripes altstripes = AltStripes();
-TestPattern testpattern = TestPattern();
-SwirlPaint swirlpaint = SwirlPaint();
-
-// given a pattern id, return that model
-// eg. getPattern(PATTERNS::BLANK) returns blank object.
-Pattern* getPattern(int p) {
-  switch (p) {
-    case PATTERNS::BLANK:
-      return &blank;
-    case PATTERNS::ORNAMENTS:
-      return &ornaments;
-    case PATTERNS::CHASE1:
-      return &chase1;
-    case PATTERNS::CHASE2:
-      return &chase2;
-    case PATTERNS::FLASHROW:
-      return &flashrow;
-    case PATTERNS::FLASHRING:
-      return &flashring;
-    case PATTERNS::RADIO:
-      return &christmasradio;
-    case PATTERNS::EYE:
-      return &eye;
-    case PATTERNS::FIRE:
-      return &fire;
-    case PATTERNS::BOUNCINGBALL:
-      return &bouncingball;
-    case PATTERNS::LOUDNESS:
-      return &loudness;
-    case PATTERNS::FALLINGSTAR:
-      return &fallingstar;
-    case PATTERNS::SPARKLE:
-      return &sparkle;
-    case PATTERNS::WIGGLE:
-      return &wiggle;
-    case PATTERNS::DIAGONAL:
-      return &diagonal;
-    case PATTERNS::FIREWORKS:
-      return &fireworks;
-    case PATTERNS::ALTSTRIPES:
-      return &altstripes;
-    case PATTERNS::TESTPATTERN:
-      return &testpattern;
-    case PATTERNS::SWIRLPAINT:
-      return &swirlpaint;
-  }
-}
+//All patterns, in the same order as PATTERNS::PATTERN. Patterns are constructed by PatternManager when used.
+typedef PatternTypes<
+  Blank,
+  Ornaments,
+  Chase1,
+  Chase2,
+  FlashRow,
+  FlashRing,
+  ChristmasRadio,
+  Eye,
+  Fire,
+  BouncingBall,
+  Loudness,
+  FallingStar,
+  Sparkle,
+  Wiggle,
+  Diagonal,
+  Fireworks,
+  AltStripes,
+  SwirlPaint,
+  TestPattern
+> patterntypes;
+static_assert(patterntypes::count == PATTERNS::PATTERN_COUNT, "patterntypes must list every pattern");
+//Limit on the state of a single pattern, two are allocated.
+//This is a build error rather than a surprise when the stack runs into the heap.
+#define PATTERN_SLOT_LIMIT 512
+//Also checked by the host build in Test/. Every type there is at least as large as on the board, so a pattern that
+//fits there fits on the board. Patterns keep large arrays of longs as int32_t, so they aren't doubled there.
+static_assert(PatternArena<patterntypes>::SLOT_SIZE <= PATTERN_SLOT_LIMIT, "a pattern is larger than PATTERN_SLOT_LIMIT");
 
 class PatternManager {
     //Number of frames during which both patterns should be cross-faded
     const int TRANSITION_FRAMES = 75;
 
+    //state of the current and next patterns
+    PatternArena<patterntypes> arena;
+    //arena slot holding the current pattern, the other holds the next pattern during a transition
+    int currentslot = 0;
     //Pattern currently being used
     int currentpattern = 0;
     //the next pattern to use, or 0 if not in transition
     int nextpattern = 0;
-    //frame counter for the transition period
+    //frames into the transition period, 0 before it starts
     int transition_status = 0;
+    //when the transition started, by the pattern clock
+    unsigned long transitionstart;
     CRGB spare[NUM_LEDS];
+    //average time each pattern's update() takes, in microseconds, 0 if not yet run
+    unsigned int cost[PATTERNS::PATTERN_COUNT] = {0};
+    //fade and mix only the blocks patterns wrote to. Cleared to process every led, to compare the two.
+    bool skipclean = true;
 
   public: PatternManager() {
     }
 
 
     void setup() {
+      jump(PATTERNS::BLANK);
     }
 
     void update() {
       //Debug/testing. Manually set single pattern to use.
       if (false) {
-        currentpattern = PATTERNS::DIAGONAL;
-        if(framenumber==1) getPattern(currentpattern)->setup();
-        getPattern(currentpattern)->update(leds);
+        if(framenumber==1) jump(PATTERNS::DIAGONAL);
+        getPattern()->update(leds);
         return;
       }
       //Check if we are transitioning
       if (nextpattern) {
         if (transition_status == 0) {
           //Setup pattern on first frame
-          getPattern(nextpattern)->setup();
+          getNextPattern()->setup();
+          transitionstart = patternenvironment.millis();
         }
-        if (transition_status < TRANSITION_FRAMES) {
-          transition_status ++;
+        //timed by the clock rather than frames rendered, so it takes as long when the loop is slow
+        long elapsed = (patternenvironment.millis() - transitionstart) / FRAME_MS;
+        if (elapsed < TRANSITION_FRAMES) {
+          transition_status = elapsed + 1;
         } else {
-          //Transition complete
+          //Transition complete, the old pattern is no longer needed
+          arena.destroy(currentslot);
+          currentslot = 1 - currentslot;
           currentpattern = nextpattern;
           nextpattern = 0;
           transition_status = 0;
         }
       }
       //Run pattern
-      getPattern(currentpattern)->update(leds);
+      unsigned long start = micros();
+      getPattern()->update(leds);
+      measure(currentpattern, start);
       //If we are transitioning crossfade the new pattern
       if (nextpattern) {
         //Fade the current framebuffer
         int fade_percent = 255 * transition_status / TRANSITION_FRAMES;
         fade_percent = sin8((fade_percent / 2 + 64) % 256);
-        for (int i = 0; i < NUM_LEDS; i++) {
-          leds[i].nscale8(fade_percent);
+        DirtyBlocks* dirty = skipclean ? getPattern()->getDirty() : NULL;
+        for (int block = 0; block < DIRTY_BLOCKS; block++) {
+          //untouched blocks are black, so dont need fading
+          if (dirty && !dirty->isDirty(block)) continue;
+          int last = min((block + 1) * DIRTY_BLOCK_SIZE, NUM_LEDS);
+          for (int i = block * DIRTY_BLOCK_SIZE; i < last; i++) {
+            leds[i].nscale8(fade_percent);
+          }
         }
         //Call new patter, writing into a spare buffer
-        getPattern(nextpattern)->update(spare);
+        start = micros();
+        getNextPattern()->update(spare);
+        measure(nextpattern, start);
         //Mix pattern into main buffer
-        for (int i = 0; i < NUM_LEDS; i++) {
-          spare[i].nscale8(255 - fade_percent);
-          leds[i] += spare[i];
+        dirty = skipclean ? getNextPattern()->getDirty() : NULL;
+        for (int block = 0; block < DIRTY_BLOCKS; block++) {
+          //untouched blocks are black, so would add nothing
+          if (dirty && !dirty->isDirty(block)) continue;
+          int last = min((block + 1) * DIRTY_BLOCK_SIZE, NUM_LEDS);
+          for (int i = block * DIRTY_BLOCK_SIZE; i < last; i++) {
+            spare[i].nscale8(255 - fade_percent);
+            leds[i] += spare[i];
+          }
         }
       }
     }
 
     //Start transition into new pattern
     void transition(int pattern) {
+      //replaces any transition already in progress
+      arena.create(1 - currentslot, pattern);
       nextpattern = pattern;
       transition_status = 0;
     }
 
+    //Switch to a new pattern immediately, without crossfading
+    void jump(int pattern) {
+      arena.destroy(1 - currentslot);
+      arena.create(currentslot, pattern);
+      currentpattern = pattern;
+      nextpattern = 0;
+      transition_status = 0;
+      getPattern()->setup();
+    }
+
+    //the pattern being displayed
+    Pattern* getPattern() {
+      return arena.get(currentslot);
+    }
+
+    //the pattern being faded in, if in transition
+    Pattern* getNextPattern() {
+      return arena.get(1 - currentslot);
+    }
+
+    void setSkipClean(bool skip) {
+      skipclean = skip;
+    }
+
+    //average time the pattern takes to render a frame, in microseconds
+    unsigned int getCost(int pattern) {
+      return cost[pattern];
+    }
+
+  private:
+    //adds the time since start to the pattern's average
+    void measure(int pattern, unsigned long start) {
+      long elapsed = min(micros() - start, 65535UL);
+      if (cost[pattern] == 0) cost[pattern] = elapsed;
+      else cost[pattern] += (elapsed - long(cost[pattern])) / 8;
+    }
+
+};
+
+
+//One pattern in a playlist
+struct PlaylistEntry {
+  byte pattern;
+  //how long the pattern is displayed, in seconds
+  unsigned int duration;
+  //relative chance of being picked in a shuffled playlist, at least 1
+  byte weight;
 };
 
+//Patterns to display, played in order or shuffled
+struct Playlist {
+  const PlaylistEntry* entries;
+  byte length;
+  //pick entries at random by weight, never the same one twice in a row
+  bool shuffle;
+};
+
+const PlaylistEntry quiet_entries[] PROGMEM = {
+  {PATTERNS::EYE, 60, 1},
+};
+const PlaylistEntry medium_entries[] PROGMEM = {
+  {PATTERNS::ORNAMENTS, 60, 1},
+  {PATTERNS::FALLINGSTAR, 60, 1},
+  {PATTERNS::DIAGONAL, 60, 1},
+  {PATTERNS::SWIRLPAINT, 60, 1},
+};
+const PlaylistEntry loud_entries[] PROGMEM = {
+  {PATTERNS::RADIO, 60, 1},
+  {PATTERNS::FIRE, 60, 1},
+  {PATTERNS::CHASE1, 60, 1},
+  {PATTERNS::BOUNCINGBALL, 60, 1},
+  {PATTERNS::LOUDNESS, 60, 1},
+  {PATTERNS::SPARKLE, 60, 1},
+  {PATTERNS::FIREWORKS, 60, 1},
+};
+const PlaylistEntry demo_entries[] PROGMEM = {
+  {PATTERNS::SWIRLPAINT, 120, 1},
+  {PATTERNS::ALTSTRIPES, 120, 1},
+  {PATTERNS::SPARKLE, 120, 1},
+  {PATTERNS::DIAGONAL, 120, 1},
+  {PATTERNS::FALLINGSTAR, 120, 1},
+  {PATTERNS::RADIO, 120, 1},
+  {PATTERNS::FIRE, 120, 1},
+  {PATTERNS::CHASE1, 120, 1},
+  {PATTERNS::BOUNCINGBALL, 120, 1},
+  {PATTERNS::FIREWORKS, 120, 1},
+};
+
+#define PLAYLIST(entries, shuffle) {entries, sizeof(entries)/sizeof(entries[0]), shuffle}
+//playlist for each sound level, higher levels use the last playlist
+const Playlist playlists[] PROGMEM = {
+  PLAYLIST(quiet_entries, false),
+  PLAYLIST(medium_entries, false),
+  PLAYLIST(loud_entries, false),
+};
+//used instead of the level playlists when DEMO is set
+const Playlist demo_playlist PROGMEM = PLAYLIST(demo_entries, false);
+const int PLAYLIST_COUNT = sizeof(playlists)/sizeof(playlists[0]);
 
 //Manages which pattern is displayed, specified by newlevel(int)
 class LevelManager {
 
-    //how long (in frames) each pattern should be displayed
-    const int FRAMES_PER_PATTERN = 30*60;
     PatternManager patternmanager = PatternManager();
-    //which set of patterns are in use. Corresponds to audio level.
-    int patternset;
-    //frame counter since level was changed
-    int framessincelevelchange;
+    //which playlist is in use. Corresponds to audio level.
+    const Playlist* playlist;
+    //entry of the playlist in use, -1 before the first
+    int entry;
+    //frames until the next entry is due
+    long framesremaining;
     //current pattern in use
     PATTERNS::PATTERN currentpattern;
+    //a pattern change is due, and waiting for a beat
+    bool transitionpending = false;
+    //frames spent waiting for a beat
+    int beatwait;
+    //longest wait for a beat before changing pattern anyway
+    const int MAX_BEAT_WAIT = 30*2;
 
   public: LevelManager() {
     }
@@ -186,59 +288,30 @@ class LevelManager {
     void setup() {
       //initialise pattern manager
       patternmanager.setup();
-      //default to pattern set 1
-      patternset = 1;
-      framessincelevelchange = 0;
+      currentpattern = PATTERNS::BLANK;
+      if(DEMO) {
+        //demo starts with 1.5 sec blank before fading in first pattern
+        play(&demo_playlist);
+        framesremaining = 1.5*30;
+      } else {
+        //default to pattern set 1
+        newlevel(1);
+      }
     }
 
     void update() {
-      if(DEMO) {
-        const int frames_per_pattern = 30*120;
-        //force first frame to be 5 seconds before first pattern (0th pattern is blank)
-        if(framenumber==1) framenumber = frames_per_pattern - 1.5*30;
-        //every frames_per_pattern frames we trigger a new pattern
-        if(framenumber%frames_per_pattern==0) {
-          int patternid = (framenumber/ frames_per_pattern) - 1;
-          PATTERNS::PATTERN pattern;
-          //predefined list of patterns
-          switch (patternid % 3) {
-            case -1:
-              //demo starts with 5 sec blank before fading in first pattern
-              pattern = PATTERNS::BLANK; break;
-            case 0:
-              pattern = PATTERNS::SWIRLPAINT; break;//PATTERNS::TESTPATTERN; break;//PATTERNS::ORNAMENTS; break;
-            case 1:
-              pattern = PATTERNS::ALTSTRIPES; break;
-            case 2:
-              pattern = PATTERNS::SPARKLE; break;
-            case 3:
-              pattern = PATTERNS::DIAGONAL; break;
-            case 4:
-              pattern = PATTERNS::FALLINGSTAR; break;
-            case 5:
-              pattern = PATTERNS::RADIO; break;
-            case 6:
-              pattern = PATTERNS::FIRE; break;
-            case 7:
-              pattern = PATTERNS::CHASE1; break;
-            case 8:
-              pattern = PATTERNS::BOUNCINGBALL; break;
-            case 9:
-              pattern = PATTERNS::FIREWORKS; break;
-          };
-          patternmanager.transition(pattern);
-        }
-        patternmanager.update();
-        //dont run normal code during demo
-        return;
+      //check if its time to move to the next entry of the playlist
+      if(--framesremaining <= 0) {
+        nextentry();
+        transitionpending = true;
+        beatwait = 0;
       }
-      //patterns are displayed for a defined amount of time, each pattern in the patternset displayed in turn
-      //check if its time to change pattern within the patternset
-      if(framessincelevelchange % int(FRAMES_PER_PATTERN)==0) {
+      //changes are made on a beat, if there is one soon enough
+      if(transitionpending && (beatdetector.isBeat() || !SOUND_SENSOR || DEMO || beatwait++ >= MAX_BEAT_WAIT)) {
         transition();
+        transitionpending = false;
       }
       patternmanager.update();
-      framessincelevelchange++;
     }
 
     void transition() {
@@ -252,49 +325,52 @@ class LevelManager {
     }
     
     PATTERNS::PATTERN getnewpattern() {
-      //each pattern is plated depending on how long its been since levelchange
-      int patterncount = framessincelevelchange / FRAMES_PER_PATTERN;
-      switch (patternset) {
-        case 0:
-          switch (patterncount % 1) {
-            case 0:
-              return PATTERNS::EYE;
-          }; break;
-        case 1:
-          switch (patterncount % 4) {
-            case 0:
-              return PATTERNS::ORNAMENTS;
-            case 1:
-              return PATTERNS::FALLINGSTAR;
-            case 2:
-              return PATTERNS::DIAGONAL;
-            case 3:
-              return PATTERNS::SWIRLPAINT;
-          }; break;
-        case 2:
-          switch (patterncount % 7) {
-            case 0:
-              return PATTERNS::RADIO;
-            case 1:
-              return PATTERNS::FIRE;
-            case 2:
-              return PATTERNS::CHASE1;
-            case 3:
-              return PATTERNS::BOUNCINGBALL;
-            case 4:
-              return PATTERNS::LOUDNESS;
-            case 5:
-              return PATTERNS::SPARKLE;
-            case 6:
-              return PATTERNS::FIREWORKS;
-          }; break;
-      }
+      return PATTERNS::PATTERN(pgm_read_byte(&getEntry(entry)->pattern));
+    }
+
+    PatternManager* getPatternManager() {
+      return &patternmanager;
     }
 
-    //use new patternset
+    //use new playlist
     void newlevel(int level) {
-      patternset = level;
-      framessincelevelchange = 0;
+      if(DEMO) return;
+      play(&playlists[constrain(level, 0, PLAYLIST_COUNT-1)]);
+    }
+
+  private:
+
+    //start a playlist from the beginning on the next update
+    void play(const Playlist* p) {
+      playlist = p;
+      entry = -1;
+      framesremaining = 0;
+    }
+
+    const PlaylistEntry* getEntry(int i) {
+      return (const PlaylistEntry*)pgm_read_ptr(&playlist->entries) + i;
+    }
+
+    //move to the next entry, in order or picked by weight
+    void nextentry() {
+      int length = pgm_read_byte(&playlist->length);
+      if(!pgm_read_byte(&playlist->shuffle) || length == 1) {
+        entry = (entry + 1) % length;
+      } else {
+        unsigned int total = 0;
+        for(int i = 0; i < length; i++)
+          if(i != entry) total += pgm_read_byte(&getEntry(i)->weight);
+        int pick = random16(total);
+        for(int i = 0; i < length; i++) {
+          if(i == entry) continue;
+          pick -= pgm_read_byte(&getEntry(i)->weight);
+          if(pick < 0) {
+            entry = i;
+            break;
+          }
+        }
+      }
+      framesremaining = pgm_read_word(&getEntry(entry)->duration) * 30L;
     }
 
 };
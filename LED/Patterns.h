@@ -6,7 +6,7 @@
 /*
  * Blank (black) pattern
  */
-class Blank: public Pattern {
+class Blank: public SparsePattern {
   public: Blank() {
     }
 
@@ -14,7 +14,7 @@ class Blank: public Pattern {
     }
 
     void update(CRGB ledbuffer[]) {
-      Pattern::update(ledbuffer);
+      clear(ledbuffer);
     }
 };
 
@@ -100,7 +100,7 @@ class Ornaments: public Pattern {
  * Shows random shooting stars, moving vertically down the tree, fading in then out again.
  * A fading tail streaks behind the star.
  */
-class FallingStar: public Pattern {
+class FallingStar: public SparsePattern {
 
     //The number of shooting starts scheduled at any time
     const static int NO_ORNAMENTS = 10;
@@ -113,8 +113,8 @@ class FallingStar: public Pattern {
     //the minimum start height of each star
     const static int MIN_HEIGHT = 10;
 
-    //the start frame for the star
-    int ornament_startframe[NO_ORNAMENTS];
+    //when the star starts, in milliseconds
+    unsigned long ornament_start[NO_ORNAMENTS];
     //the row to display the star on
     int ornament_row[NO_ORNAMENTS];
     //the start height 
@@ -134,7 +134,7 @@ class FallingStar: public Pattern {
 
     void randomise(int i) {
       //set star to shoot some time in the future
-      ornament_startframe[i] = framenumber + random(DELAY);
+      ornament_start[i] = millis() + random(DELAY) * FRAME_MS;
       //on a random row
       ornament_row[i] = random(ROWS);
       //at a random height
@@ -155,10 +155,11 @@ class FallingStar: public Pattern {
 
     virtual void update(CRGB ledbuffer[]) {
       //blank canvas
-      Pattern::update(ledbuffer);
+      clear(ledbuffer);
       for (int i = 0; i < NO_ORNAMENTS; i++) {
         //if start time in the future, dont display anything
-        if (ornament_startframe[i] > framenumber) {
+        long elapsed = millis() - ornament_start[i];
+        if (elapsed < 0) {
           continue;
         }
         //for this star, how much time should it spend falling. Dependant on maxumum brighness
@@ -168,8 +169,9 @@ class FallingStar: public Pattern {
 
         //total number of frames
         int animationframes = fall + fade;
-        //which frame are we up to
-        int ornamentframe = framenumber - ornament_startframe[i];
+        //which frame are we up to, and in 1/256ths of a frame, which is also how far the star has fallen in leds
+        long position = elapsed * 256 / FRAME_MS;
+        int ornamentframe = position >> 8;
         int framesremaining = animationframes - ornamentframe;
 
         if (!(framesremaining > 0)) {
@@ -190,24 +192,24 @@ class FallingStar: public Pattern {
           setLed(ledbuffer, ornament_row[i], height, CHSV(ornament_hue[i], ornament_sat[i], bright));
         }
         if (ornamentframe < fall) {
-          //display the star, its brightness determined by a sin curve and the max brightness
-          int height = ornament_height[i] - ornamentframe;
-          unsigned int bright = sin8((map(ornamentframe, 0, fall - 1, 0, 255) + 192) % 256);
+          //display the star between leds as it falls, its brightness determined by a sin curve and the max brightness
+          long height8 = ornament_height[i] * 256L - position;
+          unsigned int bright = sin8((map(min(position, (fall - 1) * 256L), 0, (fall - 1) * 256L, 0, 255) + 192) % 256);
           bright = bright * ornament_max_brightness[i] / 255;
           //the star has lower saturation, making it whiter and brighter
-          setLed(ledbuffer, ornament_row[i], height, CHSV(ornament_hue[i], ornament_sat[i] / 2, bright));
+          canvas(ledbuffer).point(ornament_row[i] * 256, height8, CHSV(ornament_hue[i], ornament_sat[i] / 2, bright));
         }
       }
-      int sat = map(sin8((framenumber%PULSE_TIME)*256/PULSE_TIME), 0,255, 128, 0);
-      int bri = map(sin8((framenumber%PULSE_TIME)*256/PULSE_TIME), 0,255, 128, 192);
+      int sat = map(sin8((frames()%PULSE_TIME)*256/PULSE_TIME), 0,255, 128, 0);
+      int bri = map(sin8((frames()%PULSE_TIME)*256/PULSE_TIME), 0,255, 128, 192);
       for (int i = NUM_LEDS_TREE; i < NUM_LEDS; i++) {
         ledbuffer[i]=CHSV(32, sat, bri);
       }
+      dirty.mark(NUM_LEDS_TREE, NUM_LEDS - 1);
     }
     void setLed(CRGB ledbuffer[], int row, int height, CRGB colour) {
       //we dont display anything if its height is out of range
-      if (!(row >= 0 && row < ROWS && height >= 0 & height < LEDS_PER_ROW)) return;
-      ledbuffer[ledid(row, height)] = colour;
+      canvas(ledbuffer).set(row, height, colour);
     }
 };
 
@@ -216,24 +218,28 @@ class FallingStar: public Pattern {
  * red green and blue dots chace alternately up and down each strip.
  */
 class Chase1: public Pattern {
-    int position;
+    //milliseconds for the dots to move one led
+    const static int STEP_MS = FRAME_MS;
+    unsigned long start;
 
   public:
     Chase1() {
     }
 
     virtual void setup() {
-      position = 0;
+      start = millis();
     }
 
     virtual void update(CRGB ledbuffer[]) {
       Pattern::update(ledbuffer);
+      //position along the strip in 1/256ths of a led, so the dots move smoothly between leds
+      long position = (millis() - start) % (STEP_MS * LEDS_PER_ROW) * 256 / STEP_MS;
       for (int i = 0; i < ROWS; i++) {
-        ledbuffer[(position + LEDS_PER_ROW * i + 0) % int(NUM_LEDS_TREE)] = CRGB::Red;
-        ledbuffer[(position + LEDS_PER_ROW * i + 1) % int(NUM_LEDS_TREE)] = CRGB::Green;
-        ledbuffer[(position + LEDS_PER_ROW * i + 2) % int(NUM_LEDS_TREE)] = CRGB::Blue;
+        long led = position + LEDS_PER_ROW * 256L * i;
+        Canvas::linePoint(ledbuffer, NUM_LEDS_TREE, led, CRGB::Red);
+        Canvas::linePoint(ledbuffer, NUM_LEDS_TREE, led + 256, CRGB::Green);
+        Canvas::linePoint(ledbuffer, NUM_LEDS_TREE, led + 512, CRGB::Blue);
       }
-      position = (position + 1) % LEDS_PER_ROW;
     }
 
 };
@@ -241,21 +247,29 @@ class Chase1: public Pattern {
 /*
  * single led chases around the bottom row, then around the second, and so on up the tree.
  */
-class Chase2: public Pattern {
+class Chase2: public SparsePattern {
 
-    int position;
+    //milliseconds for the led to move one row
+    const static int STEP_MS = FRAME_MS;
+    unsigned long start;
 
   public: Chase2() {
     }
 
     virtual void setup() {
-      position = 0;
+      start = millis();
     }
 
     virtual void update(CRGB ledbuffer[]) {
-      Pattern::update(ledbuffer);
-      position = (position + 1) % int(NUM_LEDS_TREE);
-      ledbuffer[ledid(position % ROWS, position / ROWS)] = CRGB::White;
+      clear(ledbuffer);
+      //rows moved, in 1/256ths of a row, so the led moves smoothly between rows
+      long position = (millis() - start) % (long(STEP_MS) * NUM_LEDS_TREE) * 256 / STEP_MS;
+      int step = position >> 8;
+      int row = step % ROWS;
+      int height8 = step / ROWS * 256;
+      //on the last row of a ring, move up to the next ring as it moves round to the first row
+      if (row == ROWS - 1) height8 += position & 255;
+      canvas(ledbuffer).point(row * 256 + (position & 255), height8, CRGB::White);
     }
 
 };
@@ -263,7 +277,7 @@ class Chase2: public Pattern {
 /*
  * randomly light up a single vertical "row"
  */
-class FlashRow: public Pattern {
+class FlashRow: public SparsePattern {
 
     //the number of frames before the strip moves
     const int FRAMES_CYCLE = 12;
@@ -271,23 +285,28 @@ class FlashRow: public Pattern {
     const int FRAMES_ON = 12;
     int row;
     CHSV colour;
+    //the cycle the strip was last moved in
+    long cycle;
 
   public:
     FlashRow() {
     }
 
     virtual void setup() {
+      cycle = frames() / FRAMES_CYCLE;
     }
 
     virtual void update(CRGB ledbuffer[]) {
-      Pattern::update(ledbuffer);
-      if (framenumber % FRAMES_CYCLE == 0) {
+      clear(ledbuffer);
+      //move once a cycle, even if frames are skipped
+      if (frames() / FRAMES_CYCLE != cycle) {
+        cycle = frames() / FRAMES_CYCLE;
         row = random(ROWS);
         colour = CHSV( random8(), random8(), 64);
       }
-      if (framenumber % FRAMES_CYCLE < FRAMES_ON) {
+      if (frames() % FRAMES_CYCLE < FRAMES_ON) {
         for (int i = 0; i < LEDS_PER_ROW; i++) {
-          ledbuffer[ledid(row, i)] = colour;
+          plot(ledbuffer, ledid(row, i), colour);
         }
       }
     }
@@ -297,7 +316,7 @@ class FlashRow: public Pattern {
 /*
  * randomly light up a single ring around the tree
  */
-class FlashRing: public Pattern {
+class FlashRing: public SparsePattern {
 
     //the number of frames before the ring moves
     const int FRAMES_CYCLE = 12;
@@ -305,23 +324,28 @@ class FlashRing: public Pattern {
     const int FRAMES_ON = 12;
     int row;
     CHSV colour;
+    //the cycle the ring was last moved in
+    long cycle;
 
   public:
     FlashRing() {
     }
 
     virtual void setup() {
+      cycle = frames() / FRAMES_CYCLE;
     }
 
     virtual void update(CRGB ledbuffer[]) {
-      Pattern::update(ledbuffer);
-      if (framenumber % FRAMES_CYCLE == 0) {
+      clear(ledbuffer);
+      //move once a cycle, even if frames are skipped
+      if (frames() / FRAMES_CYCLE != cycle) {
+        cycle = frames() / FRAMES_CYCLE;
         row = random(LEDS_PER_ROW);
         colour = CHSV( random8(), random8(), 255);
       }
-      if (framenumber % FRAMES_CYCLE < FRAMES_ON) {
+      if (frames() % FRAMES_CYCLE < FRAMES_ON) {
         for (int i = 0; i < ROWS; i++) {
-          ledbuffer[ledid(i, row)] = colour;
+          plot(ledbuffer, ledid(i, row), colour);
         }
       }
     }
@@ -340,7 +364,8 @@ class ChristmasRadio: public Pattern {
     //number of frames each state is displayed for before moving the rings
     const int RING_SPEED = 2;
 
-    int ROW_COUNT = 0;
+    //when the rings started moving
+    long start;
 
     const int LEDS_IN_SEQUENCE = LEDS_PER_ROW+8;
 
@@ -349,10 +374,13 @@ class ChristmasRadio: public Pattern {
     }
 
     virtual void setup() {
+      start = frames();
     }
 
     virtual void update(CRGB ledbuffer[]) {
       Pattern::update(ledbuffer);
+      //the rings move every RING_SPEED frames, from the first update after setup()
+      int ROW_COUNT = max(frames() - start - 1, 0L) / RING_SPEED % LEDS_IN_SEQUENCE;
       CRGB RING_COLOUR;
       for (int RING = 0; RING < RING_NUMBER; RING++) {
         if (RING % 2 == 0) {
@@ -362,16 +390,11 @@ class ChristmasRadio: public Pattern {
         }
         setring(ledbuffer, (ROW_COUNT + RING * RING_SPACER) % LEDS_IN_SEQUENCE, RING_COLOUR);
       }
-      if (framenumber % RING_SPEED == 0) {
-        ROW_COUNT = (ROW_COUNT + 1) % LEDS_IN_SEQUENCE;
-      }
     }
 
     virtual void setring(CRGB ledbuffer[], int pos, CRGB color) {
       if(pos<LEDS_PER_ROW) {
-        for (int i = 0; i < ROWS; i++) {
-          ledbuffer[ledid(i, pos)] = color;
-        }
+        canvas(ledbuffer).ring(pos, color);
       } else {
         fillstar(ledbuffer, color, pos-LEDS_PER_ROW);
       }
@@ -381,7 +404,7 @@ class ChristmasRadio: public Pattern {
 /*
  * a small pulsating circle. Used as an "off" state
  */
-class Eye: public Pattern {
+class Eye: public SparsePattern {
 
   int audiolevel;
 
@@ -393,7 +416,7 @@ class Eye: public Pattern {
     }
 
     virtual void update(CRGB ledbuffer[]) {
-      Pattern::update(ledbuffer);
+      clear(ledbuffer);
       int diff = soundlevel.getAudioLevel() - audiolevel;
       diff = constrain(diff, -2, 2);
       audiolevel += diff;
@@ -404,7 +427,7 @@ class Eye: public Pattern {
       int sat_b = 96;
       int sat_c = 72;
       //vary the brightness
-      int bright = sin8((map(framenumber % 120, 0, 120 - 1, 0, 255) + 192) % 256);
+      int bright = sin8((map(frames() % 120, 0, 120 - 1, 0, 255) + 192) % 256);
       bright = map(bright, 0, 255, 192, 255);
       bright_a = bright_a * bright / 255;
       bright_b = bright_b * bright / 255;
@@ -414,15 +437,15 @@ class Eye: public Pattern {
       sat_b = sat_b * sat / 255;
       sat_c = sat_c * sat / 255;
 
-      ledbuffer[ledid(8+1, 15)] = CHSV(0, sat_a, bright_a);
-      ledbuffer[ledid(8+0, 15)] = CHSV(0, sat_b, bright_b);
-      ledbuffer[ledid(8+2, 15)] = CHSV(0, sat_b, bright_b);
-      ledbuffer[ledid(8+1, 14)] = CHSV(0, sat_b, bright_b);
-      ledbuffer[ledid(8+1, 16)] = CHSV(0, sat_b, bright_b);
-      ledbuffer[ledid(8+0, 14)] = CHSV(0, sat_c, bright_c);
-      ledbuffer[ledid(8+0, 16)] = CHSV(0, sat_c, bright_c);
-      ledbuffer[ledid(8+2, 14)] = CHSV(0, sat_c, bright_c);
-      ledbuffer[ledid(8+2, 16)] = CHSV(0, sat_c, bright_c);
+      plot(ledbuffer, ledid(8+1, 15), CHSV(0, sat_a, bright_a));
+      plot(ledbuffer, ledid(8+0, 15), CHSV(0, sat_b, bright_b));
+      plot(ledbuffer, ledid(8+2, 15), CHSV(0, sat_b, bright_b));
+      plot(ledbuffer, ledid(8+1, 14), CHSV(0, sat_b, bright_b));
+      plot(ledbuffer, ledid(8+1, 16), CHSV(0, sat_b, bright_b));
+      plot(ledbuffer, ledid(8+0, 14), CHSV(0, sat_c, bright_c));
+      plot(ledbuffer, ledid(8+0, 16), CHSV(0, sat_c, bright_c));
+      plot(ledbuffer, ledid(8+2, 14), CHSV(0, sat_c, bright_c));
+      plot(ledbuffer, ledid(8+2, 16), CHSV(0, sat_c, bright_c));
     }
 };
 
@@ -431,6 +454,29 @@ class Eye: public Pattern {
  * adapted from http://www.tweaking4all.com/hardware/arduino/adruino-led-strip-effects/
  */
 
+//heat to colour palette for Fire: black, through red and yellow, to white
+constexpr byte heat_t192(int t) {
+  return t * 191 / 255;
+}
+constexpr byte heat_ramp(int t) {
+  return (heat_t192(t) & 0x3F) << 2;
+}
+constexpr byte heat_red(int t) {
+  return heat_t192(t) > 0x40 ? 255 : heat_ramp(t);
+}
+constexpr byte heat_green(int t) {
+  return heat_t192(t) > 0x80 ? 255 : heat_t192(t) > 0x40 ? heat_ramp(t) : 0;
+}
+constexpr byte heat_blue(int t) {
+  return heat_t192(t) > 0x80 ? heat_ramp(t) : 0;
+}
+template<typename T> struct HeatPalette;
+template<int... I> struct HeatPalette<IndexList<I...> > {
+  static const byte colour[][3];
+};
+template<int... I> const byte HeatPalette<IndexList<I...> >::colour[][3] PROGMEM = { {heat_red(I), heat_green(I), heat_blue(I)}... };
+typedef HeatPalette<MakeIndexList<256>::type> heatpalette;
+
 class Fire: public Pattern {
 
     const static byte NOROWS = 4;
@@ -449,60 +495,54 @@ class Fire: public Pattern {
     virtual void update(CRGB ledbuffer[]) {
       clear_star(ledbuffer);
       cooldown = random(0, ((Cooling * 10) / LEDS_PER_ROW) + 2);
-      if(SOUND_SENSOR) cooldown = cooldown*70/soundlevel.getAudioLevel();
+      if(SOUND_SENSOR) cooldown = cooldown*70/max(soundlevel.getAudioLevel(), 1);
       for (int i = 0; i < NOROWS; i++)
         updaterow(i, ledbuffer);
+      tileRows(ledbuffer, NOROWS);
     }
 
+    //cools, diffuses, sparks and draws a row onto the canvas in one pass
     virtual void updaterow(int row, CRGB ledbuffer[]) {
+      byte* h = heat[row];
 
-      // Step 1.  Cool down every cell a little
-      for ( int i = 0; i < LEDS_PER_ROW; i++) {
-        if (cooldown > heat[row][i]) {
-          heat[row][i] = 0;
-        } else {
-          heat[row][i] = heat[row][i] - cooldown;
-        }
-      }
-
-      // Step 2.  Heat from each cell drifts 'up' and diffuses a little
-      for ( int k = LEDS_PER_ROW - 1; k >= 2; k--) {
-        heat[row][k] = (heat[row][k - 1] + heat[row][k - 2]*2) / 3;
-      }
-
-      // Step 3.  Randomly ignite new 'sparks' near the bottom
-      int sparking = sparking;
+      // Randomly ignite a new 'spark' near the bottom, applied once heat has diffused
+      int sparking = Sparking;
       if(SOUND_SENSOR) sparking = sparking*soundlevel.getAudioLevel()/70;
-      if ( random8(255) < Sparking ) {
-        int y = random8(7);
-        heat[row][y] = heat[row][y] + random8(160, 255);
+      int sparky = -1;
+      byte spark = 0;
+      if ( random8(255) < sparking ) {
+        sparky = random8(7);
+        spark = random8(160, 255);
       }
 
-      // Step 4.  Convert heat to LED colors
-      for ( int j = 0; j < LEDS_PER_ROW; j++) {
-        setPixelHeatColor(row, ledbuffer, j, heat[row][j] );
+      // Cool every cell a little, and let heat from each cell drift 'up' and diffuse a little.
+      // Working down the row, cells below are still unchanged, so each is cooled once and carried.
+      CRGB* pixels = ledbuffer + LEDS_PER_ROW * row;
+      byte above = cool(h[LEDS_PER_ROW - 2]);
+      byte below = cool(h[LEDS_PER_ROW - 3]);
+      for (int k = LEDS_PER_ROW - 1; k >= 2; k--) {
+        //(above + below*2) / 3, without a division
+        h[k] = (uint32_t(above + below * 2) * 0xAAAB) >> 17;
+        setPixel(pixels, k, h[k]);
+        above = below;
+        if (k > 2) below = cool(h[k - 3]);
+      }
+      h[1] = cool(h[1]);
+      setPixel(pixels, 1, h[1]);
+      h[0] = cool(h[0]);
+      setPixel(pixels, 0, h[0]);
+      if (sparky >= 0) {
+        h[sparky] = h[sparky] + spark;
+        setPixel(pixels, sparky, h[sparky]);
       }
     }
 
-    void setPixelHeatColor (int row, CRGB ledbuffer[], int Pixel, byte temperature) {
-      // Scale 'heat' down from 0-255 to 0-191
-      byte t192 = (int)temperature * 191 / 255;
-
-      // calculate ramp up from
-      byte heatramp = t192 & 0x3F; // 0..63
-      heatramp <<= 2; // scale up to 0..252
+    byte cool(byte temperature) {
+      return cooldown > temperature ? 0 : temperature - cooldown;
+    }
 
-      // figure out which third of the spectrum we're in:
-      CRGB colour;
-      if ( t192 > 0x80) {                    // hottest
-        colour = CRGB(255, 255, heatramp);
-      } else if ( t192 > 0x40 ) {            // middle
-        colour = CRGB(255, heatramp, 0);
-      } else {                               // coolest
-        colour = CRGB(heatramp, 0, 0);
-      }
-      for (int i = row; i < ROWS; i += NOROWS)
-        ledbuffer[ledid(i, Pixel)] = colour;
+    void setPixel(CRGB pixels[], int height, byte temperature) {
+      memcpy_P(&pixels[height], heatpalette::colour[temperature], 3);
     }
 };
 
@@ -510,66 +550,84 @@ class Fire: public Pattern {
  * Each strip shows a red green and blue bounding dot
  * adapted from http://www.tweaking4all.com/hardware/arduino/adruino-led-strip-effects/
  */
-class BouncingBall: public Pattern {
+class BouncingBall: public SparsePattern {
 
-    const byte NOROWS=8;
+    static const byte NOROWS=8;
     CRGB colors[3] = {CRGB(0xff, 0, 0), CRGB(0xff, 0xff, 0xff), CRGB(0, 0, 0xff)};
     static const int BallCount = 3;
-    float Gravity = -9.81;
-    int StartHeight = 1;
-
-    float Height[ROWS][BallCount];
-    float ImpactVelocityStart = sqrt( -2 * Gravity * StartHeight );
-    float ImpactVelocity[ROWS][BallCount];
-    float TimeSinceLastBounce[ROWS][BallCount];
-    int   Position[ROWS][BallCount];
-    long  ClockTimeSinceLastBounce[ROWS][BallCount];
-    float Dampening[ROWS][BallCount];
+    //heights are fixed point, in 1/1024ths of the start height
+    static const int HeightScale = 1024;
+    //9.81 start heights per second^2, in 1/1024ths
+    const long Gravity = 10045;
+    //velocities are in 1/1048576ths of the start height per second, fine enough that rounding on each bounce doesn't
+    //add up to a bounce or restart a frame away from the float model's
+    //sqrt(2 * 9.81) start heights per second, reaches exactly the start height
+    const long ImpactVelocityStart = 4644612;
+    //bounces below 0.01 start heights per second restart the ball
+    const long ImpactVelocityMinimum = 10486;
+
+    //state is only kept for the simulated rows. Sized as the board's longs, so the host build's slot is no larger.
+    int32_t ImpactVelocity[NOROWS][BallCount];
+    uint32_t ClockTimeSinceLastBounce[NOROWS][BallCount];
+    //fraction of velocity kept on each bounce, in 1/5120ths, so the float model's 0.90 - random8()/1024 is exact
+    uint16_t Dampening[NOROWS][BallCount];
+    //height in 1/256ths of a led, so the balls move smoothly between leds
+    uint16_t Position[NOROWS][BallCount];
 
   public:
     BouncingBall() {
     }
 
     virtual void setup() {
-      for (int row = 0; row < ROWS; row++) {
+      for (int row = 0; row < NOROWS; row++) {
         for (int i = 0 ; i < BallCount ; i++) {
           ClockTimeSinceLastBounce[row][i] = millis();
-          Height[row][i] = StartHeight;
           Position[row][i] = 0;
           ImpactVelocity[row][i] = ImpactVelocityStart;
-          TimeSinceLastBounce[row][i] = 0;
-          Dampening[row][i] = 0.90 - float(random8()) / 1024;
+          //0.90 - random8()/1024
+          Dampening[row][i] = 4608 - 5 * random8();
         }
       }
     }
 
     virtual void update(CRGB ledbuffer[]) {
-      Pattern::update(ledbuffer);
+      //only the canvas needs blanking, the rest of the tree is copied from it
+      dirty.clear();
+      fill_solid(ledbuffer, NOROWS * LEDS_PER_ROW, CRGB::Black);
+      clear_star(ledbuffer);
       for (int row = 0; row < NOROWS; row++) {
         updaterow(row, ledbuffer);
+        CRGB* line = ledbuffer + LEDS_PER_ROW * row;
         for (int i = 0 ; i < BallCount ; i++) {
-           for(int repeat = row; repeat < ROWS; repeat+=NOROWS) {
-            ledbuffer[ledid(repeat, Position[row][i])] = colors[i];
-          }
+          Canvas::linePoint(line, LEDS_PER_ROW, Position[row][i], colors[i]);
         }
       }
+      tileRows(ledbuffer, NOROWS);
     }
 
     virtual void updaterow(int row, CRGB ledbuffer[]) {
       for (int i = 0 ; i < BallCount ; i++) {
-        TimeSinceLastBounce[row][i] =  millis() - ClockTimeSinceLastBounce[row][i];
-        Height[row][i] = 0.5 * Gravity * pow( TimeSinceLastBounce[row][i] / 1000 , 2.0 ) + ImpactVelocity[row][i] * TimeSinceLastBounce[row][i] / 1000;
-
-        if ( Height[row][i] < 0 ) {
-          Height[row][i] = 0;
-          ImpactVelocity[row][i] = Dampening[row][i] * ImpactVelocity[row][i];
+        //milliseconds since the last bounce
+        long t = millis() - ClockTimeSinceLastBounce[row][i];
+        long height;
+
+        //the ball has landed once g*t/2 exceeds v. Tested exactly, so bounces land on the same frame as the float model.
+        if ( Gravity * t > ImpactVelocity[row][i] * 125 / 64 ) {
+          height = 0;
+          //v * Dampening / 5120, split so it stays within a long
+          long v = ImpactVelocity[row][i];
+          ImpactVelocity[row][i] = v / 5120 * Dampening[row][i] + (v % 5120 * Dampening[row][i] + 2560) / 5120;
           ClockTimeSinceLastBounce[row][i] = millis();
 
-          if ( ImpactVelocity[row][i] < 0.01 ) {
+          if ( ImpactVelocity[row][i] < ImpactVelocityMinimum ) {
             ImpactVelocity[row][i] = ImpactVelocityStart;
           }
+        } else {
+          //h = v*t - g*t^2/2, with t in ms. Velocity and gravity are divided down first to stay within a long.
+          height = ImpactVelocity[row][i] / 64 * t / 16000 - (Gravity * t / 1000) * t / 2000;
+          if ( height < 0 ) height = 0;
         }
-        Position[row][i] = round( Height[row][i] * (LEDS_PER_ROW - 1) / StartHeight);
+        Position[row][i] = min(height, long(HeightScale)) * (LEDS_PER_ROW - 1) * 256 / HeightScale;
       }
 
     }
@@ -580,7 +638,7 @@ class BouncingBall: public Pattern {
  */
 class Loudness: public Pattern {
 
-    SlidingWindow history = SlidingWindow(LEDS_PER_ROW);
+    SlidingWindow<LEDS_PER_ROW> history;
 
   public:
     Loudness() {
@@ -628,7 +686,7 @@ class Loudness: public Pattern {
 /*
  * randomly lights up a number of dots every frame.
  */
-class Sparkle: public Pattern {
+class Sparkle: public SparsePattern {
 
     //number of leds lit at any one time
     const int SPARKLES = 10;
@@ -641,13 +699,13 @@ class Sparkle: public Pattern {
     }
 
     virtual void update(CRGB ledbuffer[]) {
-      Pattern::update(ledbuffer);
+      clear(ledbuffer);
       for(int i=0; i<SPARKLES; i++) {
         //1/4 leds are white, the remaining are coloured
         if(random8()<64) {
-          ledbuffer[random(NUM_LEDS)]=CRGB::White;
+          plot(ledbuffer, random(NUM_LEDS), CRGB::White);
         } else {
-          ledbuffer[random(NUM_LEDS)]=CHSV(random8(), 255, 255);
+          plot(ledbuffer, random(NUM_LEDS), CHSV(random8(), 255, 255));
         }
       }
     }
@@ -671,12 +729,13 @@ class Wiggle: public Pattern {
     virtual void update(CRGB ledbuffer[]) {
       Pattern::update(ledbuffer);
       int height = 16 * (LEDS_PER_ROW)/2 - 255/4;
-      height = height + sin8(framenumber*8)/2;
+      height = height + sin8(frames()*8)/2;
       //height of start of band
       int pos = height/16;
       //how bright the last ring should be
       int fractional = height & 0x0F;
       CRGB colour;
+      Canvas tree = canvas(ledbuffer);
       for(int i=0; i<=WIDTH; i++) {
         if(i==0) {//first ring
           colour = CHSV( 0, 0, 255 - (fractional * 16));
@@ -685,8 +744,7 @@ class Wiggle: public Pattern {
         } else {//middle rings
           colour = CHSV( 0, 0, 255);
         }
-        for(int row=0; row<ROWS; row++)
-          ledbuffer[ledid(row, pos + i)] = colour;
+        tree.ring(pos + i, colour);
       }
     }
 };
@@ -704,19 +762,22 @@ class Diagonal: public Pattern {
     }
 
     virtual void update(CRGB ledbuffer[]) {
-      //we calculate the colour of each led
+      //we calculate the colour of each led, walking up each row. Hues wrap around at 256.
+      Canvas tree = canvas(ledbuffer);
       //constant for later calculation
-      int c = 255 * 2 / ROWS;
+      byte c = 255 * 2 / ROWS;
       //start by varying all colours by frame
-      int v1 =  255 - (framenumber % 64) * 4;
-      for(int l = 0; l<LEDS_PER_ROW; l++) {
-        //vary the colour depending on height
-        int v2 = l*ROWS/2;
-        for(int row = 0; row<ROWS; row++) {
-          //vary colour based on row
-          int v3 = row * c + v2 + v1;
-          if(v3>256) v3 = v3 % 256;
-          ledbuffer[ledid(row, l)]=CHSV(v3, 255, 64);
+      byte v1 =  255 - (frames() % 64) * 4;
+      for(int row = 0; row<ROWS; row++) {
+        CRGB* led = tree.bottom(row);
+        int up = tree.up(row);
+        //vary colour based on row
+        byte hue = row * c + v1;
+        for(int l = 0; l<LEDS_PER_ROW; l++) {
+          *led = CHSV(hue, 255, 64);
+          led += up;
+          //vary the colour depending on height
+          hue += ROWS/2;
         }
       }
       copy_to_star(ledbuffer, 0);
@@ -727,7 +788,7 @@ class Diagonal: public Pattern {
  * shows random fireworks.
  * Each firework shoots up, explodes in a flash, before stars twinkle down and fade out.
  */
-class Fireworks: public Pattern {
+class Fireworks: public SparsePattern {
 
   //how many fireworks to have queued at any time
   static const int NO_FIREWORKS = 6;
@@ -753,7 +814,7 @@ class Fireworks: public Pattern {
 
     virtual void randomise(int i) {
       //start time is up to 5 seconds in the future
-      startframe[i] = framenumber + random(30*5);
+      startframe[i] = frames() + random(30*5);
       row[i] = random(ROWS);
       //rocket is red/orange/yellow
       shootcolour[i] = CHSV(random8(64), 255-random8(64), 255);
@@ -767,11 +828,11 @@ class Fireworks: public Pattern {
     }
 
     virtual void update(CRGB ledbuffer[]) {
-      Pattern::update(ledbuffer);
+      clear(ledbuffer);
       for(int i = 0; i<NO_FIREWORKS; i++) {
         //dont display if firework hasn't launched yet
-        if(framenumber<startframe[i]) continue;
-        int frame = framenumber - startframe[i];
+        if(frames()<startframe[i]) continue;
+        int frame = frames() - startframe[i];
         if(frame < SHOOT) { // rocket phase
           //calculate height with an inverse parabola. y = 1 - x^2, from x=-1..1, and y is scaled to tree height
           unsigned int height = 256*(SHOOT-frame)/SHOOT;
@@ -779,14 +840,14 @@ class Fireworks: public Pattern {
           height = (65536 - height) / 256 * LEDS_PER_ROW / 256;
           CHSV c = shootcolour[i];
           //draw a bright dot
-          ledbuffer[ledidC(row[i], height)]=c;
+          plot(ledbuffer, ledidC(row[i], height), c);
           //draw two leds for a tail, each half the brightness of the last
           c.value = 128;
-          ledbuffer[ledidC(row[i], height-1)]=c;
+          plot(ledbuffer, ledidC(row[i], height-1), c);
           c.value = 64;
-          ledbuffer[ledidC(row[i], height-2)]=c;
+          plot(ledbuffer, ledidC(row[i], height-2), c);
           //if we have already reached the top of the tree, jump ahead
-          if(height==LEDS_PER_ROW-1) startframe[i] = framenumber - SHOOT - 1;
+          if(height==LEDS_PER_ROW-1) startframe[i] = frames() - SHOOT - 1;
         } else if(frame < SHOOT + EXPLODE) { // initial explosion
           frame-=SHOOT;
           //we draw a white circle if increasing size
@@ -798,7 +859,7 @@ class Fireworks: public Pattern {
               //circle centre
               int o_x = row[i];
               int o_y = LEDS_PER_ROW - 1;
-              ledbuffer[ledidC(o_x + x, o_y + y)]=CRGB::White;
+              plot(ledbuffer, ledidC(o_x + x, o_y + y), CRGB::White);
             }
           }
         } else if(frame < SHOOT + EXPLODE + 8) {//explosion
@@ -819,7 +880,7 @@ class Fireworks: public Pattern {
               c1.value = random8(c1.value*2);
               int o_x = row[i];
               int o_y = height;
-              ledbuffer[ledidC(o_x + x, o_y + y)]=c1;
+              plot(ledbuffer, ledidC(o_x + x, o_y + y), c1);
             }
           }
         } else if(frame < SHOOT + EXPLODE + FALL) {
@@ -844,7 +905,7 @@ class Fireworks: public Pattern {
               c1.value = c1.value * height / LEDS_PER_ROW ;
               int o_x = row[i];
               int o_y = height;
-              ledbuffer[ledidC(o_x + x, o_y + y)]=c1;
+              plot(ledbuffer, ledidC(o_x + x, o_y + y), c1);
             }
           }
         } else {
@@ -1057,7 +1118,7 @@ class SwirlPaint: public Pattern {
 /*
  * test
  */
-class TestPattern: public Pattern {
+class TestPattern: public SparsePattern {
     int position;
 
   public:
@@ -1069,9 +1130,9 @@ class TestPattern: public Pattern {
     }
 
     virtual void update(CRGB ledbuffer[]) {
-      Pattern::update(ledbuffer);
-      if(position%2==0) ledbuffer[starid(1,position/2, 0)]=CRGB::White;
-      else              ledbuffer[starid(1,position/2, 2)]=CRGB::White;
+      clear(ledbuffer);
+      if(position%2==0) plot(ledbuffer, starid(1,position/2, 0), CRGB::White);
+      else              plot(ledbuffer, starid(1,position/2, 2), CRGB::White);
       position = (position + 1) % (STAR_POINTS*2);
     }
 };
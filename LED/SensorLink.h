@@ -0,0 +1,180 @@
+#include "SensorProtocol.h"
+
+/*
+ * Requests and reads levels from the Sensor board without blocking the frame.
+ * A reading is requested once a frame has been shown, and collected at the start of the next frame.
+ * If the Sensor board doesn't answer in time the last values are kept, and the request is retried.
+ *
+ * Readings can be captured to Serial, and replayed from Serial in place of the Sensor board, so a run can be
+ * reproduced. Tools/sensorlog.py records and plays back the log, which has one record per frame:
+ *  SENSOR_LOG_READING, light level, audio level (2 bytes, little endian)   a reading arrived this frame
+ *  SENSOR_LOG_NONE                                                         no reading this frame
+ * When replaying, the board sends SENSOR_LOG_REQUEST once a frame, and waits for the next record, so each frame sees
+ * the record logged for it however late it arrives. Test/Replay.cpp plays a log through the sketch on a PC.
+ * Serial carries the log in both modes, so Console is off while capturing or replaying.
+ */
+
+//Frame signal to Sensor Board
+#define FRAME_SIGNAL_DPIN 3
+//Sensor board link speed, must match Sensor.ino
+#define SENSOR_BAUD 38400
+//frames to wait for a reading before asking again
+#define SENSOR_TIMEOUT_FRAMES 3
+//how long a replay waits for the next record before keeping the last values
+#define SENSOR_REPLAY_TIMEOUT_MS 1000
+
+//where readings come from. SENSOR_CAPTURE also logs them to Serial, SENSOR_REPLAY reads a log from Serial.
+#define SENSOR_LIVE    0
+#define SENSOR_CAPTURE 1
+#define SENSOR_REPLAY  2
+//the host build in Test/ sets it to replay a log
+#ifndef SENSOR_SOURCE
+#define SENSOR_SOURCE  SENSOR_LIVE
+#endif
+
+//log record types, outside the ascii range so they can be picked out from debug messages
+#define SENSOR_LOG_READING 0xF0
+#define SENSOR_LOG_NONE    0xF1
+#define SENSOR_LOG_REQUEST 0xF2
+
+class SensorLink {
+
+    SensorParser parser;
+    //the last reading, from the Sensor board or a replayed log
+    SensorReading reading;
+    //frames since a reading was requested, or -1 if no request is outstanding
+    int waiting;
+    //number of requests the Sensor board, or a replayed log, failed to answer
+    unsigned int timeouts;
+
+  public:
+    SensorLink() {
+      waiting = -1;
+      timeouts = 0;
+      memset(&reading, 0, sizeof(reading));
+    }
+
+    void setup() {
+      //the log takes the place of the Sensor board. Ask for the first frame's record.
+      if(SENSOR_SOURCE == SENSOR_REPLAY) {
+        request();
+        return;
+      }
+      Serial3.begin(SENSOR_BAUD);
+      pinMode(FRAME_SIGNAL_DPIN, OUTPUT);
+      //Reset frame signal and clear serial buffer
+      digitalWrite(FRAME_SIGNAL_DPIN, LOW);
+      delay(5);
+      while(Serial3.available()) Serial3.read();
+      //ask for the first reading
+      request();
+    }
+
+    //Signal Sensor board to send data, to be collected by poll() next frame
+    void request() {
+      if(SENSOR_SOURCE == SENSOR_REPLAY) {
+        Serial.write(SENSOR_LOG_REQUEST);
+        return;
+      }
+      if(waiting >= 0) return;
+      digitalWrite(FRAME_SIGNAL_DPIN, HIGH);
+      waiting = 0;
+    }
+
+    //Collects a reading if one has arrived. Returns true if new values were received.
+    bool poll() {
+      if(SENSOR_SOURCE == SENSOR_REPLAY) return replay();
+      bool received = false;
+      while(Serial3.available()) {
+        if(parser.feed(Serial3.read())) received = true;
+      }
+      if(received) reading = parser.getReading();
+      if(SENSOR_SOURCE == SENSOR_CAPTURE) capture(received);
+      if(received) {
+        //drop the signal so the next request is a new rising edge
+        digitalWrite(FRAME_SIGNAL_DPIN, LOW);
+        waiting = -1;
+      } else if(waiting >= 0 && ++waiting > SENSOR_TIMEOUT_FRAMES) {
+        //give up, and let request() raise the signal again
+        digitalWrite(FRAME_SIGNAL_DPIN, LOW);
+        waiting = -1;
+        timeouts++;
+      }
+      return received;
+    }
+
+    unsigned int getLightLevel() {
+      return reading.lightlevel;
+    }
+
+    unsigned int getAudioLevel() {
+      return reading.audiolevel;
+    }
+
+    //number of audio samples the last audio level was measured over, not available when replaying
+    unsigned int getSamples() {
+      return reading.samples;
+    }
+
+    //energy in a frequency band, 0-255. Band 0 is the lowest frequency. Not available when replaying.
+    //Not used by any pattern yet, for patterns that follow the music by frequency.
+    byte getBand(int band) {
+      return reading.bands[band];
+    }
+
+    //readings lost in transit
+    unsigned int getDrops() {
+      return parser.getDrops();
+    }
+
+    //readings rejected as corrupt
+    unsigned int getCrcErrors() {
+      return parser.getCrcErrors();
+    }
+
+    unsigned int getTimeouts() {
+      return timeouts;
+    }
+
+  private:
+    //logs this frame's reading, if any
+    void capture(bool received) {
+      if(!received) {
+        Serial.write(SENSOR_LOG_NONE);
+        return;
+      }
+      Serial.write(SENSOR_LOG_READING);
+      Serial.write(byte(reading.lightlevel));
+      Serial.write(byte(reading.audiolevel & 255));
+      Serial.write(byte(reading.audiolevel >> 8));
+    }
+
+    //takes the next record of a replayed log, waiting up to SENSOR_REPLAY_TIMEOUT_MS for all of it to arrive.
+    //Returns false for a frame logged without a reading, or if the record doesn't arrive in time.
+    bool replay() {
+      unsigned long start = millis();
+      while(millis() - start < SENSOR_REPLAY_TIMEOUT_MS) {
+        if(!Serial.available()) continue;
+        int type = Serial.peek();
+        if(type == SENSOR_LOG_NONE) {
+          Serial.read();
+          return false;
+        }
+        if(type == SENSOR_LOG_READING) {
+          //wait for the whole record
+          if(Serial.available() < 4) continue;
+          Serial.read();
+          reading.lightlevel = Serial.read();
+          reading.audiolevel = Serial.read();
+          reading.audiolevel |= Serial.read() << 8;
+          return true;
+        }
+        //not part of the log
+        Serial.read();
+      }
+      timeouts++;
+      return false;
+    }
+};
+
+SensorLink sensorlink = SensorLink();
@@ -0,0 +1,131 @@
+/*
+ * Records how long each stage of recent frames took, to find where overruns come from.
+ * dump() sends the record over Serial in a compact binary format, decoded by Tools/telemetry.py, along with the
+ * frame rate from framescheduler, the health of the link to the Sensor board and the cost of each pattern.
+ */
+
+//The stages of a frame that are timed
+namespace STAGES {
+  enum STAGE {
+    SENSOR,   //waiting for and reading the Sensor board
+    PATTERN,  //levelmanager.update()
+    OVERLAY,  //soundpeak, framestatus and other overlays
+    OUTPUTSTAGE, //outputstage, gamma, brightness and dithering
+    SHOW,     //FastLED.show()
+    //number of stages, not a stage
+    STAGE_COUNT
+  };
+};
+
+class FrameTelemetry {
+
+    //format of dump(), increment if it changes
+    static const byte VERSION = 4;
+    //number of recent frames kept
+    static const int FRAMES = 32;
+    //histogram of whole frame times, the last bucket also counts anything longer
+    static const int BUCKETS = 16;
+    static const int BUCKET_MS = 4;
+
+    //time each stage took in recent frames, in microseconds
+    unsigned int timings[FRAMES][STAGES::STAGE_COUNT];
+    unsigned int minimum[STAGES::STAGE_COUNT];
+    unsigned int maximum[STAGES::STAGE_COUNT];
+    unsigned int histogram[BUCKETS];
+    //number of frames longer than the frame time
+    unsigned int overruns;
+    //position in timings of the current frame
+    byte current;
+    //number of valid frames in timings
+    byte recorded;
+    unsigned long stagestart;
+
+  public:
+    FrameTelemetry() {
+      reset();
+    }
+
+    void reset() {
+      for (int s = 0; s < STAGES::STAGE_COUNT; s++) {
+        minimum[s] = 65535;
+        maximum[s] = 0;
+      }
+      for (int i = 0; i < BUCKETS; i++) {
+        histogram[i] = 0;
+      }
+      overruns = 0;
+      current = 0;
+      recorded = 0;
+    }
+
+    void startFrame() {
+      for (int s = 0; s < STAGES::STAGE_COUNT; s++) {
+        timings[current][s] = 0;
+      }
+      stagestart = micros();
+    }
+
+    //records the time since the last stage ended (or the frame started) against the given stage
+    void endStage(int stage) {
+      unsigned long now = micros();
+      unsigned long elapsed = min(now - stagestart, 65535UL);
+      stagestart = now;
+      timings[current][stage] = elapsed;
+      if (elapsed < minimum[stage]) minimum[stage] = elapsed;
+      if (elapsed > maximum[stage]) maximum[stage] = elapsed;
+    }
+
+    //frame_time is the target frame time in ms
+    void endFrame(int frame_time) {
+      unsigned long total = 0;
+      for (int s = 0; s < STAGES::STAGE_COUNT; s++) {
+        total += timings[current][s];
+      }
+      int bucket = min(total / 1000 / BUCKET_MS, (unsigned long)(BUCKETS - 1));
+      if (histogram[bucket] < 65535) histogram[bucket]++;
+      if (total > frame_time * 1000UL && overruns < 65535) overruns++;
+      current = (current + 1) % FRAMES;
+      if (recorded < FRAMES) recorded++;
+    }
+
+    /*
+     * Binary format, all values little endian unsigned 16 bit unless noted:
+     *  'T', version (byte), stage count (byte), frame count (byte), bucket count (byte), bucket width ms (byte)
+     *  minimum[stages], maximum[stages], histogram[buckets], overruns
+     *  timings[frames][stages], oldest frame first
+     *  frames shown in the last second (byte), frames not shown, times the scheduler fell too far behind
+     *  sensor readings lost in transit, rejected as corrupt, and requests that timed out
+     *  pattern count (byte), average update() time of each pattern in microseconds, 0 if not run
+     */
+    void dump() {
+      Serial.write('T');
+      Serial.write(VERSION);
+      Serial.write(byte(STAGES::STAGE_COUNT));
+      Serial.write(recorded);
+      Serial.write(byte(BUCKETS));
+      Serial.write(byte(BUCKET_MS));
+      for (int s = 0; s < STAGES::STAGE_COUNT; s++) write16(minimum[s]);
+      for (int s = 0; s < STAGES::STAGE_COUNT; s++) write16(maximum[s]);
+      for (int i = 0; i < BUCKETS; i++) write16(histogram[i]);
+      write16(overruns);
+      for (int f = 0; f < recorded; f++) {
+        int frame = (current - recorded + f + FRAMES) % FRAMES;
+        for (int s = 0; s < STAGES::STAGE_COUNT; s++) write16(timings[frame][s]);
+      }
+      Serial.write(framescheduler.getFps());
+      write16(framescheduler.getDrops());
+      write16(framescheduler.getResyncs());
+      write16(min(sensorlink.getDrops(), 65535U));
+      write16(min(sensorlink.getCrcErrors(), 65535U));
+      write16(min(sensorlink.getTimeouts(), 65535U));
+      Serial.write(byte(PATTERNS::PATTERN_COUNT));
+      for (int p = 0; p < PATTERNS::PATTERN_COUNT; p++) write16(levelmanager.getPatternManager()->getCost(p));
+    }
+
+    void write16(unsigned int v) {
+      Serial.write(byte(v & 255));
+      Serial.write(byte(v >> 8));
+    }
+};
+
+FrameTelemetry telemetry = FrameTelemetry();
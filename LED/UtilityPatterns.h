@@ -5,12 +5,16 @@
 #include "Common.h"
 #include "Audio.h"
 #include "LedCalculations.h"
+#include "Canvas.h"
 
 /*
  * base class, by default blanks all LEDs
  */
 class Pattern {
   public:
+    //patterns are destroyed when PatternManager is finished with them
+    virtual ~Pattern() {
+    }
     //This is called everytime the pattern starts to be used
     virtual void setup() {
     }
@@ -32,6 +36,111 @@ class Pattern {
         ledbuffer[i] = CRGB::Black;
       }
     }
+
+    //returns the leds written by the last update(), or NULL if any led may have been written
+    virtual DirtyBlocks* getDirty() {
+      return NULL;
+    }
+
+  protected:
+    //for drawing on the tree as a cylinder
+    Canvas canvas(CRGB ledbuffer[]) {
+      return Canvas(ledbuffer);
+    }
+
+    //For patterns that simulate a few rows and repeat them around the tree. The first `rows` rows of ledbuffer
+    //are drawn as a canvas, each indexed by height whichever way its strip runs, then copied to every
+    //`rows`th row in strip order. Rows running downwards are reversed once, and the other copies taken from it.
+    void tileRows(CRGB ledbuffer[], int rows) {
+      for (int row = 0; row < rows; row++) {
+        CRGB* source = ledbuffer + LEDS_PER_ROW * row;
+        CRGB* reversed = NULL;
+        for (int target = row + rows; target < ROWS; target += rows) {
+          CRGB* pixels = ledbuffer + LEDS_PER_ROW * target;
+          if (ledrow_upwards(target)) {
+            memcpy(pixels, source, LEDS_PER_ROW * sizeof(CRGB));
+          } else if (reversed) {
+            memcpy(pixels, reversed, LEDS_PER_ROW * sizeof(CRGB));
+          } else {
+            for (int i = 0; i < LEDS_PER_ROW; i++) pixels[i] = source[LEDS_PER_ROW - 1 - i];
+            reversed = pixels;
+          }
+        }
+        //the source row is put in strip order last, once nothing else is copied from it
+        if (ledrow_upwards(row)) continue;
+        if (reversed) {
+          memcpy(source, reversed, LEDS_PER_ROW * sizeof(CRGB));
+        } else {
+          for (int i = 0; i < LEDS_PER_ROW / 2; i++) {
+            CRGB swap = source[i];
+            source[i] = source[LEDS_PER_ROW - 1 - i];
+            source[LEDS_PER_ROW - 1 - i] = swap;
+          }
+        }
+      }
+    }
+
+    //These hide FastLED's random8() and Arduino's random() and millis(), so every pattern draws from
+    //patternenvironment, and a run can be repeated exactly. random() supports ranges up to 65536.
+    static byte random8() {
+      return patternenvironment.random16() >> 8;
+    }
+    static byte random8(byte lim) {
+      return (random8() * lim) >> 8;
+    }
+    static byte random8(byte min, byte lim) {
+      return min + random8(lim - min);
+    }
+    static long random(long max) {
+      return (uint32_t(patternenvironment.random16()) * max) >> 16;
+    }
+    static long random(long min, long max) {
+      return min + random(max - min);
+    }
+    static unsigned long millis() {
+      return patternenvironment.millis();
+    }
+    //millis() in frames, for patterns that step once a frame. Unlike framenumber it counts frames due rather than
+    //frames rendered, so when the loop is slow steps are skipped and the pattern keeps its speed.
+    static long frames() {
+      return millis() / FRAME_MS;
+    }
+};
+
+/*
+ * base class for patterns that only light a few leds.
+ * Leds must be written with plot(), so PatternManager only fades and mixes the blocks that were touched.
+ */
+class SparsePattern: public Pattern {
+  protected:
+    DirtyBlocks dirty;
+
+    //blanks all LEDs, and marks them all as untouched
+    void clear(CRGB ledbuffer[]) {
+      Pattern::update(ledbuffer);
+      dirty.clear();
+    }
+
+    void plot(CRGB ledbuffer[], int led, CRGB colour) {
+      ledbuffer[led] = colour;
+      dirty.mark(led);
+    }
+
+    //as Pattern::canvas(), marking everything drawn
+    Canvas canvas(CRGB ledbuffer[]) {
+      return Canvas(ledbuffer, &dirty);
+    }
+
+    //as Pattern::tileRows(). Every tree row is copied, so all are marked as written.
+    void tileRows(CRGB ledbuffer[], int rows) {
+      Pattern::tileRows(ledbuffer, rows);
+      dirty.mark(0, NUM_LEDS_TREE - 1);
+    }
+
+  public:
+    virtual DirtyBlocks* getDirty() {
+      return &dirty;
+    }
 };
 
 /*
@@ -39,11 +148,12 @@ class Pattern {
  */
 class SoundPeak: public Pattern {
 
-  int frames;
+  //frames left of the flash
+  int flashframes;
   const int maxframes = 7;
   
   public: SoundPeak() {
-    frames = 0;
+    flashframes = 0;
   }
   
   void setup() {
@@ -51,21 +161,21 @@ class SoundPeak: public Pattern {
 
   void update() {
     CRGB color ;
-    //a sound peak occurs if current volume is twice the average volume
-    if(soundlevel.getLastVolume()>soundlevel.getAudioLevel()*2) {
-      frames=maxframes;
-      color = CHSV(random8(), 255, 255);
+    //flash on each beat
+    if(beatdetector.isBeat()) {
+      flashframes=maxframes;
+      //an overlay, so it uses the board's random numbers rather than the patterns', which stay repeatable
+      color = CHSV(::random8(), 255, 255);
       for(int i=0; i<50; i++) {
-        leds[random(NUM_LEDS)]=color;
+        leds[::random(NUM_LEDS)]=color;
       }
     }
-    if(frames>0) {
-      color = CHSV(0,0,255*frames*frames/(maxframes*maxframes));
-      for(int i = 0; i<ROWS; i++) {
-        leds[LEDS_PER_ROW * i]=color;
-        leds[LEDS_PER_ROW * i+29]=color;
-      }
-      frames--;
+    if(flashframes>0) {
+      color = CHSV(0,0,255*flashframes*flashframes/(maxframes*maxframes));
+      Canvas tree = canvas(leds);
+      tree.ring(0, color);
+      tree.ring(LEDS_PER_ROW - 1, color);
+      flashframes--;
     }
   }
 
@@ -90,6 +200,8 @@ class SoundLevelStatus: public Pattern {
         color=CRGB::Green; break;
       case 2:
         color=CRGB::Blue; break;
+      default:
+        color=CRGB::White; break;
     }    
     for(int i = 1; i<soundlevel.getLevel()+2; i++) {
       leds[ledid(i,0)]=color;
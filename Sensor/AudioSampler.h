@@ -0,0 +1,45 @@
+/*
+ * Samples audio continuously, using the ADC in free running mode.
+ * Each conversion raises an interrupt that stores the sample in a ring buffer, emptied from the main loop with read(int&).
+ * SoftwareSerial disables interrupts while it sends each byte, longer than a conversion takes, so a few samples are
+ * lost whenever a reading is sent with mySerial.write().
+ */
+
+//ADC clock prescaler. 16MHz/64 = 250kHz, at 13 clocks a conversion gives 19.2kHz sampling
+#define ADC_PRESCALER (_BV(ADPS2) | _BV(ADPS1))
+
+#include "SampleRing.h"
+
+class AudioSampler {
+
+    byte channel;
+
+  public:
+    SampleRing ring;
+
+    AudioSampler(byte c) {
+      channel = c;
+    }
+
+    //starts free running conversions of the audio channel
+    void start() {
+      //AVcc reference, the same as analogRead()
+      ADMUX = _BV(REFS0) | (channel & 7);
+      //free running trigger
+      ADCSRB = 0;
+      //writing ADIF clears the flag left by any analogRead() since stop(), which would otherwise
+      //raise the interrupt at once and store that reading as an audio sample
+      ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIE) | _BV(ADIF) | ADC_PRESCALER;
+    }
+
+    //stops sampling, so analogRead() can be used on another channel
+    void stop() {
+      ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+      //wait for the conversion in progress
+      while(ADCSRA & _BV(ADSC));
+    }
+
+    bool read(int &sample) {
+      return ring.pop(sample);
+    }
+};
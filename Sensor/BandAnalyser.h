@@ -0,0 +1,124 @@
+/*
+ * Measures audio energy in a number of frequency bands, using a bank of fixed point Goertzel filters.
+ * update(int) is fed every ADC sample. Samples are decimated by DECIMATION, then run through each filter
+ * in blocks of BLOCK_SIZE. getBand(int) returns the loudest block in each band since reset().
+ * The bands are sent to the LED board with each reading, where nothing uses them yet. They are there for patterns
+ * that follow the music by frequency.
+ *
+ * Cost on the Uno, counted from the code avr-gcc generates for each step rather than measured on a board: each
+ * decimated sample takes about 1150 cycles, 8 filters of a 16x32 bit multiply (~40), a 14 bit shift of a long (~30)
+ * and the long loads, stores and adds (~60). endBlock() takes about 6400, mostly the 8 square roots. At 30 frames a
+ * second that is 160 samples and 2.5 blocks, about 200000 of the 533000 cycles in a frame (38%). The 640 ADC
+ * interrupts and draining them from the ring take about another 15%, and sending the reading blocks for 4.7ms, 14%
+ * of the frame, leaving about a third spare. Set ANALYSIS_DEBUG in Sensor.ino to print the actual cycles per frame.
+ */
+
+#define BANDS 8
+//19.2kHz / 4 = 4.8kHz analysis rate, bands up to 2.4kHz
+#define DECIMATION 4
+//64 samples at 4.8kHz is 13.3ms, a resolution of 75Hz
+#define BLOCK_SIZE 64
+//decimated samples the bias is averaged over, 0.2s. Much shorter, and it follows and distorts the lowest band.
+#define DC_AVERAGE 1024
+
+//2*cos(2*pi*k/BLOCK_SIZE) in 1/16384ths, for bins k = 1, 2, 3, 5, 8, 12, 17, 24
+//75, 150, 225, 375, 600, 900, 1275 and 1800Hz
+const int band_coefficients[BANDS] PROGMEM = {32610, 32138, 31357, 28899, 23170, 12540, -3212, -23170};
+//sin(2*pi*k/BLOCK_SIZE) in 1/16384ths, for the same bins
+const int band_sines[BANDS] PROGMEM = {1606, 3196, 4756, 7723, 11585, 15137, 16305, 11585};
+
+class BandAnalyser {
+
+    //coefficients copied from flash
+    int coefficient[BANDS];
+    int sine[BANDS];
+    //filter state for each band, the last two outputs
+    long s1[BANDS];
+    long s2[BANDS];
+    //loudest block in each band since reset
+    byte peak[BANDS];
+    //running average of the input, DC_AVERAGE times the decimated sum
+    long dc;
+    //sum of samples for the current decimated sample
+    int sum;
+    byte decimate;
+    byte position;
+
+  public:
+    BandAnalyser() {
+      for (int i = 0; i < BANDS; i++) {
+        coefficient[i] = (int16_t)pgm_read_word(&band_coefficients[i]);
+        sine[i] = (int16_t)pgm_read_word(&band_sines[i]);
+        s1[i] = 0;
+        s2[i] = 0;
+      }
+      //the microphone amplifier is biased to half supply
+      dc = 512L * DECIMATION * DC_AVERAGE;
+      sum = 0;
+      decimate = 0;
+      position = 0;
+      reset();
+    }
+
+    void update(int sample) {
+      sum += sample;
+      if (++decimate < DECIMATION) return;
+      decimate = 0;
+      //remove the bias, and scale to +/-128. The shift divides by DECIMATION * 4, and adding half first rounds to the
+      //nearest step, so quiet tones aren't lost. Averaging the decimated samples filters out some aliasing.
+      dc += sum - dc / DC_AVERAGE;
+      int x = constrain((sum - int(dc / DC_AVERAGE) + DECIMATION * 2) >> 4, -127, 127);
+      sum = 0;
+      for (int i = 0; i < BANDS; i++) {
+        long s0 = x + ((coefficient[i] * s1[i]) >> 14) - s2[i];
+        s2[i] = s1[i];
+        s1[i] = s0;
+      }
+      if (++position == BLOCK_SIZE) {
+        position = 0;
+        endBlock();
+      }
+    }
+
+    //magnitude of each band over the block, about twice the amplitude of a tone in the band
+    void endBlock() {
+      for (int i = 0; i < BANDS; i++) {
+        //the real and imaginary parts of the bin. Squaring these, rather than s1^2 + s2^2 - coefficient*s1*s2,
+        //avoids taking the difference of large numbers, which lost quiet low bands.
+        long re = s1[i] - ((coefficient[i] * s2[i]) >> 15);
+        long im = (sine[i] * s2[i]) >> 14;
+        unsigned int magnitude = (isqrt(re * re + im * im) + 8) >> 4;
+        if (magnitude > 255) magnitude = 255;
+        if (magnitude > peak[i]) peak[i] = magnitude;
+        s1[i] = 0;
+        s2[i] = 0;
+      }
+    }
+
+    void reset() {
+      for (int i = 0; i < BANDS; i++) {
+        peak[i] = 0;
+      }
+    }
+
+    byte getBand(int band) {
+      return peak[band];
+    }
+
+    //integer square root
+    static unsigned int isqrt(unsigned long v) {
+      unsigned long result = 0;
+      unsigned long bit = 1UL << 30;
+      while (bit > v) bit >>= 2;
+      while (bit) {
+        if (v >= result + bit) {
+          v -= result + bit;
+          result = (result >> 1) + bit;
+        } else {
+          result >>= 1;
+        }
+        bit >>= 2;
+      }
+      return result;
+    }
+};
@@ -0,0 +1,50 @@
+/*
+ * The buffer between the ADC interrupt and the main loop, kept apart from AudioSampler so it builds without the ADC
+ * registers, for the host tests.
+ */
+
+//must be a power of 2
+#define SAMPLE_BUFFER_SIZE 64
+
+/*
+ * Lock free ring buffer for one writer (the interrupt) and one reader (the main loop).
+ * The head is only written by push(), the tail only by pop(). Both are single bytes so are read atomically.
+ */
+class SampleRing {
+
+    volatile int samples[SAMPLE_BUFFER_SIZE];
+    volatile byte head;
+    volatile byte tail;
+    //samples dropped because the buffer was full
+    volatile unsigned int overflows;
+
+  public:
+    SampleRing() {
+      head = 0;
+      tail = 0;
+      overflows = 0;
+    }
+
+    //Adds a sample. If the buffer is full the sample is dropped.
+    void push(int sample) {
+      byte next = (head + 1) & (SAMPLE_BUFFER_SIZE - 1);
+      if(next == tail) {
+        overflows++;
+        return;
+      }
+      samples[head] = sample;
+      head = next;
+    }
+
+    //Takes the oldest sample. Returns false if there are none.
+    bool pop(int &sample) {
+      if(tail == head) return false;
+      sample = samples[tail];
+      tail = (tail + 1) & (SAMPLE_BUFFER_SIZE - 1);
+      return true;
+    }
+
+    unsigned int getOverflows() {
+      return overflows;
+    }
+};
@@ -1,11 +1,20 @@
 
 #include <SoftwareSerial.h>
 #include "Common.h"
+#include "SensorProtocol.h"
+#include "AudioSampler.h"
+#include "BandAnalyser.h"
 
 #define FRAME_SIGNAL_DPIN 10
 #define SOFTWARE_SERIAL_DPIN 9
 #define AUDIO_APIN 0
 #define LIGHT_SENSOR_APIN 1
+//LED board link speed, must match SensorLink.h. Fast enough to send a frame in under 5ms.
+#define SENSOR_BAUD 38400
+//Reports the time spent on band analysis over Serial
+#define ANALYSIS_DEBUG false
+
+static_assert(BANDS == SENSOR_BANDS, "band analysis must match the protocol");
 
 //low_fuses=0xff
 //high_fuses=0xde
@@ -14,24 +23,44 @@
 SoftwareSerial mySerial(0, SOFTWARE_SERIAL_DPIN); // dont care about read pin, we never read.
 
 MinMax minmax;
+BandAnalyser bands;
+SensorReading reading;
+AudioSampler sampler(AUDIO_APIN);
+
+//store each audio sample as it is converted
+ISR(ADC_vect) {
+  sampler.ring.push(ADC);
+}
 
 void setup() {
   //Debugging
   Serial.begin(250000);
   //Comm to LED board
-  mySerial.begin(9600);
+  mySerial.begin(SENSOR_BAUD);
   //Initialise the audio levels
   minmax = MinMax();
+  reading.sequence = 0;
+  sampler.start();
 }
 
 bool signalpin = false;
 unsigned long watchdog;
 
-void listen(unsigned long duration) {
-  //Spend 1ms reading in audio data
-  WaitFor timer = WaitFor(duration);
-  while(timer.wait()) {
-    minmax.update(analogRead(AUDIO_APIN));
+//microseconds spent in band analysis since the last frame
+unsigned long analysistime = 0;
+
+void listen() {
+  //feed audio samples collected by the interrupt into the levels
+  int sample;
+  while(sampler.read(sample)) {
+    minmax.update(sample);
+    if(ANALYSIS_DEBUG) {
+      unsigned long start = micros();
+      bands.update(sample);
+      analysistime += micros() - start;
+    } else {
+      bands.update(sample);
+    }
   }
 }
 
@@ -42,22 +71,33 @@ void loop() {
     //Send data to LED board
 
     //Fetch audio and read light data
-    unsigned int audiolevel = minmax.getRange();
-    unsigned int lightlevel = analogRead(LIGHT_SENSOR_APIN);
-    /*  Arrange data into two bytes
-     *  llllllaa aaaaaaaa
-     *  6 bits (0-63) for light, 10 bits (0-1023) for audio */
-    lightlevel = (lightlevel / 16) << 10;
-    audiolevel |= lightlevel;
-    //send two bytes to LED board
-    mySerial.write(byte(42));
-    mySerial.write(byte(audiolevel>>8));
-    mySerial.write(byte(audiolevel&255));
+    listen();
+    reading.audiolevel = minmax.getRange();
+    reading.samples = minmax.getSamples();
+    for(int i = 0; i < BANDS; i++) {
+      reading.bands[i] = bands.getBand(i);
+    }
+    //6 bits (0-63) for light. Audio sampling is paused while the light is read.
+    sampler.stop();
+    reading.lightlevel = analogRead(LIGHT_SENSOR_APIN) / 16;
+    sampler.start();
+    //send frame to LED board
+    byte frame[SENSOR_MAX_FRAME];
+    int len = encodeSensorReading(reading, frame);
+    mySerial.write(frame, len);
+    reading.sequence++;
+    if(ANALYSIS_DEBUG) {
+      //16 cycles per microsecond
+      Serial.print(F("analysis cycles/frame "));
+      Serial.println(analysistime * 16);
+      analysistime = 0;
+    }
     //reset audio levels
     minmax.reset();
+    bands.reset();
     watchdog = millis();
   } else {
-    listen(1);
+    listen();
   }
   signalpin = signalpinval;
 }
@@ -0,0 +1,151 @@
+/*
+ * Frame format for readings sent from the Sensor board to the LED board.
+ * Used by both sketches. LED/SensorProtocol.h and Sensor/SensorProtocol.h must be kept identical.
+ *
+ *  byte 0       SENSOR_SYNC
+ *  byte 1       version
+ *  byte 2       payload length
+ *  byte 3       sequence number, incremented every frame
+ *  payload
+ *  last byte    CRC-8 (polynomial 0x07) of bytes 1 to the end of the payload
+ *
+ * Version 1 payload, little endian:
+ *  light level   1 byte, 0-63
+ *  audio level   2 bytes, 0-1023
+ *  samples       2 bytes, number of audio samples the level was measured over
+ *  bands         SENSOR_BANDS bytes, energy in each frequency band (0-255), lowest frequency first.
+ *                Frames from before bands were added don't have them, and are read as silent.
+ *
+ * New fields are added to the end of the payload. Readers ignore fields they don't know,
+ * the version only changes if the meaning of an existing field does.
+ */
+#define SENSOR_SYNC             0xA5
+#define SENSOR_PROTOCOL_VERSION 1
+#define SENSOR_HEADER_SIZE      4
+#define SENSOR_BANDS            8
+#define SENSOR_PAYLOAD_SIZE     (5 + SENSOR_BANDS)
+//shortest payload accepted, without bands
+#define SENSOR_MIN_PAYLOAD      5
+//largest payload accepted, leaving room for fields added later
+#define SENSOR_MAX_PAYLOAD      24
+#define SENSOR_MAX_FRAME        (SENSOR_HEADER_SIZE + SENSOR_MAX_PAYLOAD + 1)
+
+struct SensorReading {
+  byte sequence;
+  byte lightlevel;
+  unsigned int audiolevel;
+  unsigned int samples;
+  byte bands[SENSOR_BANDS];
+};
+
+//CRC-8, polynomial x^8 + x^2 + x + 1
+byte sensorCrc(byte crc, byte data) {
+  crc ^= data;
+  for (int i = 0; i < 8; i++) {
+    crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+//Writes a frame for the reading to buffer, which must hold SENSOR_MAX_FRAME bytes. Returns the frame length.
+int encodeSensorReading(const SensorReading& reading, byte buffer[]) {
+  int len = 0;
+  buffer[len++] = SENSOR_SYNC;
+  buffer[len++] = SENSOR_PROTOCOL_VERSION;
+  buffer[len++] = SENSOR_PAYLOAD_SIZE;
+  buffer[len++] = reading.sequence;
+  buffer[len++] = reading.lightlevel;
+  buffer[len++] = reading.audiolevel & 255;
+  buffer[len++] = reading.audiolevel >> 8;
+  buffer[len++] = reading.samples & 255;
+  buffer[len++] = reading.samples >> 8;
+  for (int i = 0; i < SENSOR_BANDS; i++) buffer[len++] = reading.bands[i];
+  byte crc = 0;
+  for (int i = 1; i < len; i++) crc = sensorCrc(crc, buffer[i]);
+  buffer[len++] = crc;
+  return len;
+}
+
+/*
+ * Assembles frames one byte at a time. feed(byte) never blocks, and returns true when a valid frame completes.
+ * Counts frames lost (gaps in the sequence) and frames rejected by the CRC.
+ */
+class SensorParser {
+
+    byte buffer[SENSOR_MAX_FRAME];
+    int received;
+    SensorReading reading;
+    bool synced;
+    unsigned int drops;
+    unsigned int crcerrors;
+
+  public:
+    SensorParser() {
+      received = 0;
+      synced = false;
+      drops = 0;
+      crcerrors = 0;
+    }
+
+    bool feed(byte data) {
+      if (received == 0 && data != SENSOR_SYNC) return false;
+      buffer[received++] = data;
+      bool complete = false;
+      //a bad frame may hide the start of a good one, so keep checking until nothing more can be decided
+      while (received > 0) {
+        if (received > 2 && buffer[2] > SENSOR_MAX_PAYLOAD) {
+          resync();
+          continue;
+        }
+        if (received < SENSOR_HEADER_SIZE + 1 || received < SENSOR_HEADER_SIZE + buffer[2] + 1) break;
+        byte crc = 0;
+        for (int i = 1; i < received - 1; i++) crc = sensorCrc(crc, buffer[i]);
+        if (crc != buffer[received - 1]) {
+          crcerrors++;
+          resync();
+          continue;
+        }
+        if (decode()) complete = true;
+        received = 0;
+      }
+      return complete;
+    }
+
+    //the last valid reading
+    const SensorReading& getReading() {
+      return reading;
+    }
+
+    unsigned int getDrops() {
+      return drops;
+    }
+
+    unsigned int getCrcErrors() {
+      return crcerrors;
+    }
+
+  private:
+    bool decode() {
+      //frames too short for this version's fields are ignored
+      if (buffer[1] != SENSOR_PROTOCOL_VERSION || buffer[2] < SENSOR_MIN_PAYLOAD) return false;
+      byte sequence = buffer[3];
+      if (synced) drops += byte(sequence - reading.sequence - 1);
+      synced = true;
+      reading.sequence = sequence;
+      reading.lightlevel = buffer[4];
+      reading.audiolevel = buffer[5] | (buffer[6] << 8);
+      reading.samples = buffer[7] | (buffer[8] << 8);
+      for (int i = 0; i < SENSOR_BANDS; i++) {
+        reading.bands[i] = buffer[2] >= SENSOR_PAYLOAD_SIZE ? buffer[9 + i] : 0;
+      }
+      return true;
+    }
+
+    //drops the first byte, and restarts from the next sync byte already received
+    void resync() {
+      int start = 1;
+      while (start < received && buffer[start] != SENSOR_SYNC) start++;
+      memmove(buffer, buffer + start, received - start);
+      received -= start;
+    }
+};
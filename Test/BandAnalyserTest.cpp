@@ -0,0 +1,91 @@
+/*
+ * BandAnalyser.h: the fixed point Goertzel filters measure synthetic tones within a couple of counts of a floating
+ * point Goertzel over the same decimated samples, for tones on and between the bins, quiet to clipping, and mixtures.
+ */
+#include <Arduino.h>
+#include "../Sensor/BandAnalyser.h"
+#include "HostTest.h"
+
+//Sensor board ADC rate
+const double SAMPLE_RATE = 19200;
+const int BINS[BANDS] = {1, 2, 3, 5, 8, 12, 17, 24};
+//blocks fed for each signal
+const int BLOCKS = 8;
+
+struct Tone {
+  double frequency;
+  //in ADC counts, about the 512 bias
+  double amplitude;
+};
+
+int adcSample(const std::vector<Tone>& tones, long n) {
+  double v = 512;
+  for(const Tone& tone : tones) v += tone.amplitude * sin(2 * M_PI * tone.frequency * n / SAMPLE_RATE);
+  return constrain(int(lround(v)), 0, 1023);
+}
+
+//the float model: the same decimation and clipping, then an exact Goertzel on each block
+void floatBands(const std::vector<Tone>& tones, double bands[BANDS]) {
+  for(int i = 0; i < BANDS; i++) bands[i] = 0;
+  long n = 0;
+  for(int block = 0; block < BLOCKS; block++) {
+    double s1[BANDS] = {0}, s2[BANDS] = {0};
+    for(int position = 0; position < BLOCK_SIZE; position++) {
+      double sum = 0;
+      for(int d = 0; d < DECIMATION; d++) sum += adcSample(tones, n++);
+      double x = constrain((sum - 512.0 * DECIMATION) / (DECIMATION * 4), -127.0, 127.0);
+      for(int i = 0; i < BANDS; i++) {
+        double c = 2 * cos(2 * M_PI * BINS[i] / BLOCK_SIZE);
+        double s0 = x + c * s1[i] - s2[i];
+        s2[i] = s1[i];
+        s1[i] = s0;
+      }
+    }
+    for(int i = 0; i < BANDS; i++) {
+      double c = 2 * cos(2 * M_PI * BINS[i] / BLOCK_SIZE);
+      //BandAnalyser scales the filter state down by 16 before squaring
+      double magnitude = sqrt(fmax(s1[i] * s1[i] + s2[i] * s2[i] - c * s1[i] * s2[i], 0)) / 16;
+      bands[i] = fmax(bands[i], fmin(magnitude, 255));
+    }
+  }
+}
+
+double worst = 0;
+
+void compare(const std::vector<Tone>& tones, const char* name) {
+  BandAnalyser analyser;
+  for(long n = 0; n < long(BLOCKS) * BLOCK_SIZE * DECIMATION; n++) analyser.update(adcSample(tones, n));
+  double expected[BANDS];
+  floatBands(tones, expected);
+  for(int i = 0; i < BANDS; i++) {
+    //a couple of counts for the rounded samples and filter state, or 2% of a loud band
+    double tolerance = fmax(2, expected[i] * 0.02);
+    worst = fmax(worst, fabs(analyser.getBand(i) - expected[i]));
+    if(!CHECK_NEAR(analyser.getBand(i), expected[i], tolerance)) fprintf(stderr, "%s, band %d\n", name, i);
+  }
+}
+
+int main() {
+  char name[64];
+  //on each bin, quiet to clipping
+  for(int i = 0; i < BANDS; i++) {
+    double frequency = SAMPLE_RATE / DECIMATION * BINS[i] / BLOCK_SIZE;
+    for(double amplitude : {8.0, 40.0, 120.0, 250.0, 500.0, 700.0}) {
+      snprintf(name, sizeof(name), "%.0fHz at %.0f", frequency, amplitude);
+      compare({{frequency, amplitude}}, name);
+    }
+  }
+  //between bins, and above the top band
+  for(double frequency : {50.0, 110.0, 300.0, 480.0, 750.0, 1100.0, 1500.0, 2100.0, 2350.0}) {
+    snprintf(name, sizeof(name), "%.0fHz", frequency);
+    compare({{frequency, 200}}, name);
+  }
+  //chords, each band sees its own tone and the others' leakage
+  compare({{75, 150}, {600, 100}, {1800, 60}}, "75Hz + 600Hz + 1800Hz");
+  compare({{150, 200}, {225, 200}}, "150Hz + 225Hz");
+  compare({{375, 80}, {900, 80}, {1275, 80}, {2000, 80}}, "375Hz + 900Hz + 1275Hz + 2000Hz");
+  //the bias alone measures nothing
+  compare({}, "silence");
+  printf("furthest from the float model: %.2f\n", worst);
+  return finish("BandAnalyserTest");
+}
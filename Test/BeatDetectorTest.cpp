@@ -0,0 +1,98 @@
+/*
+ * Audio.h's BeatDetector: volume traces with beats at known times, on a noisy background, are detected on the beat,
+ * with few beats reported between them. The tempo and beat phase follow the trace, and a steady loud trace has no beats.
+ */
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "HostTest.h"
+
+const long SECOND = 1000 / FRAME_MS;
+//time for the history to fill and the tempo to settle, not counted
+const long WARMUP = 5 * SECOND;
+const long FRAMES = 120 * SECOND;
+
+//repeatable noise, so a failure can be reproduced
+uint32_t noise = 11;
+int randomVolume(int low, int high) {
+  noise = noise * 1103515245 + 12345;
+  return low + (noise >> 16) % (high - low + 1);
+}
+
+//ms from the last beat of a trace at bpm to time t, in ms
+double sinceBeat(double t, int bpm) {
+  return fmod(t, 60000.0 / bpm);
+}
+
+//a kick of varying strength at each beat that dies away over a few frames, on a noisy background
+int beatVolume(long frame, int bpm) {
+  static int strength = 0;
+  double since = sinceBeat(frame * FRAME_MS, bpm);
+  int frames = since / FRAME_MS;
+  if(frames == 0) strength = randomVolume(120, 250);
+  int kick = frames < 4 ? strength >> frames : 0;
+  return randomVolume(20, 100) + kick;
+}
+
+//runs the trace at bpm through a detector. A beat detected on the frame of a kick, or the one after, is a hit,
+//any other is a false positive.
+void testTempo(int bpm) {
+  BeatDetector detector;
+  double period = 60000.0 / bpm;
+  long beats = 0, hits = 0, falsepositives = 0;
+  //the last kick a beat was detected for, so each is counted once
+  long lastkick = -1;
+  //frames the phase is checked on, and those within two frames of the trace's at the fastest tempo
+  long phases = 0, inphase = 0;
+  for(long frame = 0; frame < FRAMES; frame++) {
+    framenumber = frame;
+    host::now = uint64_t(frame) * FRAME_MS * 1000;
+    detector.update(beatVolume(frame, bpm));
+    if(frame < WARMUP) continue;
+    double t = frame * FRAME_MS;
+    long kick = long(t / period);
+    //a kick falls in this frame
+    if(sinceBeat(t, bpm) < FRAME_MS) beats++;
+    if(detector.isBeat()) {
+      if(sinceBeat(t, bpm) < 2 * FRAME_MS && kick != lastkick) {
+        hits++;
+        lastkick = kick;
+      } else {
+        falsepositives++;
+      }
+    }
+    //the phase, once the tempo has settled. A missed beat leaves it out until the next one.
+    if(frame >= 2 * WARMUP) {
+      int expected = sinceBeat(t, bpm) * 256 / period;
+      int difference = abs(int(detector.beatPhase()) - expected);
+      phases++;
+      if(min(difference, 256 - difference) <= 2 * FRAME_MS * 256 * 150 / 60000) inphase++;
+    }
+  }
+  printf("%d bpm: %ld beats, %ld hits, %ld false positives, %u bpm measured, %ld%% of frames in phase\n",
+         bpm, beats, hits, falsepositives, detector.bpm(), inphase * 100 / phases);
+  CHECK(hits >= beats * 90 / 100);
+  CHECK(falsepositives <= beats / 20);
+  CHECK_NEAR(detector.bpm(), bpm, bpm * 0.05);
+  CHECK(inphase >= phases * 90 / 100);
+}
+
+//a loud trace with no beats in it reports none, once the history is full
+void testSteady() {
+  BeatDetector detector;
+  long beats = 0;
+  for(long frame = 0; frame < FRAMES; frame++) {
+    framenumber = frame;
+    host::now = uint64_t(frame) * FRAME_MS * 1000;
+    detector.update(randomVolume(590, 610));
+    if(frame >= WARMUP && detector.isBeat()) beats++;
+  }
+  CHECK_EQUAL(beats, 0);
+}
+
+int main() {
+  testTempo(90);
+  testTempo(120);
+  testTempo(150);
+  testSteady();
+  return finish("BeatDetectorTest");
+}
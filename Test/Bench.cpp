@@ -0,0 +1,261 @@
+/*
+ * The pattern benchmark from Benchmark.h, run on a PC and timed by its clock, for profiling patterns without a board.
+ * Each pattern is rendered BENCHMARK_FRAMES times after a run to warm the caches, reporting mean, p50 and p99 ns/frame.
+ * Times are the PC's, useful to compare changes against each other rather than as the board's.
+ * Build and run with `make bench`.
+ */
+#define HOST_REAL_CLOCK
+//before the shim, whose min and max macros break it
+#include <algorithm>
+#include <Arduino.h>
+#define BENCHMARK_CLOCK host::nanos()
+#define BENCHMARK_TICKS_PER_US 1000
+#define BENCHMARK_FRAMES 1000
+#include "../LED/LED.ino"
+#include "PatternNames.h"
+
+//mean, p50 and p99 of some times in ns, on one line after a label
+void report(const char* label, std::vector<unsigned long> samples) {
+  std::sort(samples.begin(), samples.end());
+  unsigned long long total = 0;
+  for(unsigned long sample : samples) total += sample;
+  printf("%-44s mean %6llu p50 %6lu p99 %6lu ns\n", label, total / samples.size(), samples[samples.size() / 2],
+         samples[samples.size() * 99 / 100]);
+}
+
+//times step(i) for BENCHMARK_FRAMES frames, each after an untimed prepare(i)
+void bench(const char* label, std::function<void(int)> prepare, std::function<void(int)> step) {
+  std::vector<unsigned long> samples;
+  for(int i = 0; i < BENCHMARK_FRAMES; i++) {
+    prepare(i);
+    unsigned long start = host::nanos();
+    step(i);
+    samples.push_back(host::nanos() - start);
+  }
+  report(label, samples);
+}
+
+//the output stage on a frame of Fire, against the brightness scaling FastLED did in show() before it
+void benchOutputStage() {
+  static CRGB frame[NUM_LEDS];
+  patternenvironment.setFrameTime(FRAME_TIME);
+  levelmanager.getPatternManager()->jump(PATTERNS::FIRE);
+  for(int i = 0; i < 30; i++) levelmanager.getPatternManager()->getPattern()->update(leds);
+  memcpy(frame, leds, sizeof(leds));
+  auto restore = [](int i) { memcpy(leds, frame, sizeof(leds)); };
+  bench("brightness scaling only, as before", restore, [](int i) {
+    for(int led = 0; led < NUM_LEDS; led++) leds[led].nscale8(128);
+  });
+  OutputStage stage = OutputStage();
+  bench("output stage", restore, [&](int i) {
+    stage.setBrightness(128);
+    stage.apply(leds);
+  });
+  bench("output stage, brightness changing", restore, [&](int i) {
+    stage.setBrightness(i);
+    stage.apply(leds);
+  });
+}
+
+//ledid() and ledidC() as they were before the lookup tables
+int oldledid(int row, int height) {
+  while(row<0) row+=ROWS;
+  if(row>=int(ROWS))
+    row = row % int(ROWS);
+  int r = LEDS_PER_ROW * row;
+  while(height<0) height+=LEDS_PER_ROW;
+  if(height >=int(LEDS_PER_ROW))
+    height = height % int(LEDS_PER_ROW);
+  if(row%2==0) {
+    r+=height;
+  } else {
+    r+=LEDS_PER_ROW - 1 - height;
+  }
+  return r;
+}
+
+int oldledidC(int row, int height) {
+  while(row<0) row+=ROWS;
+  if(row>=int(ROWS))
+    row = row % int(ROWS);
+  int r = LEDS_PER_ROW * row;
+  height = constrain(height, 0, LEDS_PER_ROW-1);
+  if(row%2==0) {
+    r+=height;
+  } else {
+    r+=LEDS_PER_ROW - 1 - height;
+  }
+  return r;
+}
+
+//keeps the results of the led id sweeps, so they aren't optimised away
+volatile long sink;
+
+//every row and height up to one wrap out of range each way, as patterns that wrap around the tree ask for them
+void sweep(int (*id)(int, int)) {
+  long total = 0;
+  for(int row = -ROWS; row < 2 * ROWS; row++) {
+    for(int height = -LEDS_PER_ROW; height < 2 * LEDS_PER_ROW; height++) total += id(row, height);
+  }
+  sink = total;
+}
+
+//the led id lookup tables against the arithmetic they replaced, checking both give the same ids
+void benchLedId() {
+  int mismatches = 0;
+  for(int row = -ROWS; row < 2 * ROWS; row++) {
+    for(int height = -LEDS_PER_ROW; height < 2 * LEDS_PER_ROW; height++) {
+      if(ledid(row, height) != oldledid(row, height) || ledidC(row, height) != oldledidC(row, height)) mismatches++;
+    }
+  }
+  auto none = [](int i) {};
+  printf("led id sweeps of %d calls, %d ids differing from the old arithmetic\n", 9 * ROWS * LEDS_PER_ROW, mismatches);
+  bench("ledid() sweep, arithmetic, as before", none, [](int i) { sweep(oldledid); });
+  bench("ledid() sweep, lookup table", none, [](int i) { sweep(ledid); });
+  bench("ledidC() sweep, arithmetic, as before", none, [](int i) { sweep(oldledidC); });
+  bench("ledidC() sweep, lookup table", none, [](int i) { sweep(ledidC); });
+}
+
+//Fire as it was before its passes were fused, with the spark rate fixed the same way
+class OldFire: public Fire {
+  public:
+    virtual void update(CRGB ledbuffer[]) {
+      clear_star(ledbuffer);
+      cooldown = random(0, ((Cooling * 10) / LEDS_PER_ROW) + 2);
+      if(SOUND_SENSOR) cooldown = cooldown*70/max(soundlevel.getAudioLevel(), 1);
+      for (int i = 0; i < NOROWS; i++)
+        updaterow(i, ledbuffer);
+    }
+
+    virtual void updaterow(int row, CRGB ledbuffer[]) {
+      // Step 1.  Cool down every cell a little
+      for ( int i = 0; i < LEDS_PER_ROW; i++) {
+        if (cooldown > heat[row][i]) {
+          heat[row][i] = 0;
+        } else {
+          heat[row][i] = heat[row][i] - cooldown;
+        }
+      }
+
+      // Step 2.  Heat from each cell drifts 'up' and diffuses a little
+      for ( int k = LEDS_PER_ROW - 1; k >= 2; k--) {
+        heat[row][k] = (heat[row][k - 1] + heat[row][k - 2]*2) / 3;
+      }
+
+      // Step 3.  Randomly ignite new 'sparks' near the bottom
+      int sparking = Sparking;
+      if(SOUND_SENSOR) sparking = sparking*soundlevel.getAudioLevel()/70;
+      if ( random8(255) < sparking ) {
+        int y = random8(7);
+        heat[row][y] = heat[row][y] + random8(160, 255);
+      }
+
+      // Step 4.  Convert heat to LED colors
+      for ( int j = 0; j < LEDS_PER_ROW; j++) {
+        setPixelHeatColor(row, ledbuffer, j, heat[row][j] );
+      }
+    }
+
+    void setPixelHeatColor (int row, CRGB ledbuffer[], int Pixel, byte temperature) {
+      // Scale 'heat' down from 0-255 to 0-191
+      byte t192 = (int)temperature * 191 / 255;
+
+      // calculate ramp up from
+      byte heatramp = t192 & 0x3F; // 0..63
+      heatramp <<= 2; // scale up to 0..252
+
+      // figure out which third of the spectrum we're in:
+      CRGB colour;
+      if ( t192 > 0x80) {                    // hottest
+        colour = CRGB(255, 255, heatramp);
+      } else if ( t192 > 0x40 ) {            // middle
+        colour = CRGB(255, heatramp, 0);
+      } else {                               // coolest
+        colour = CRGB(heatramp, 0, 0);
+      }
+      for (int i = row; i < ROWS; i += NOROWS)
+        ledbuffer[ledid(i, Pixel)] = colour;
+    }
+};
+
+//renders a second of a Fire to warm it up, from the same random state each time
+void startFire(Fire& fire) {
+  patternenvironment.seed(PATTERNS::FIRE);
+  fire.setup();
+  for(int i = 0; i < 30; i++) fire.update(leds);
+}
+
+//Fire's fused kernel against the one it replaced, checking both draw the same frames
+void benchFire() {
+  static OldFire oldfire;
+  static Fire fire;
+  static CRGB frames[BENCHMARK_FRAMES][NUM_LEDS];
+  auto none = [](int i) {};
+  startFire(oldfire);
+  //each frame is kept before the next is drawn
+  bench("Fire, separate passes, as before", [](int i) {
+    if(i > 0) memcpy(frames[i - 1], leds, sizeof(leds));
+  }, [](int i) {
+    oldfire.update(leds);
+  });
+  memcpy(frames[BENCHMARK_FRAMES - 1], leds, sizeof(leds));
+  startFire(fire);
+  int differences = 0;
+  bench("Fire, fused pass and heat palette", none, [&](int i) {
+    fire.update(leds);
+    if(memcmp(frames[i], leds, sizeof(leds))) differences++;
+  });
+  printf("Fire frames differing from the old kernel: %d\n", differences);
+}
+
+//PatternManager::update() through a crossfade between every pair of sparse patterns, fading and mixing only the
+//blocks they wrote, or every led
+void benchCrossfades() {
+  PatternManager* manager = levelmanager.getPatternManager();
+  std::vector<int> sparse;
+  for(int p = 0; p < PATTERNS::PATTERN_COUNT; p++) {
+    manager->jump(p);
+    if(dynamic_cast<SparsePattern*>(manager->getPattern())) sparse.push_back(p);
+  }
+  for(int skipclean = 1; skipclean >= 0; skipclean--) {
+    manager->setSkipClean(skipclean);
+    std::vector<unsigned long> samples;
+    for(int from : sparse) {
+      for(int to : sparse) {
+        if(from == to) continue;
+        framenumber = 0;
+        patternenvironment.setFrameTime(FRAME_TIME);
+        manager->jump(from);
+        manager->transition(to);
+        //the transition and the frame it ends on
+        for(int i = 0; i < 76; i++) {
+          framenumber++;
+          unsigned long start = host::nanos();
+          manager->update();
+          samples.push_back(host::nanos() - start);
+        }
+      }
+    }
+    report(skipclean ? "sparse crossfades, clean blocks skipped" : "sparse crossfades, every led", samples);
+  }
+  manager->setSkipClean(true);
+}
+
+int main() {
+  Serial.sink = stdout;
+  printf("pattern slot size %d bytes, %d frames each\n", int(PatternArena<patterntypes>::SLOT_SIZE), BENCHMARK_FRAMES);
+  printf("name          pattern mean(ns) p50(ns) p99(ns) cycles/frame crossfade-p50(ns) crossfade-p99(ns) crc\n");
+  for(int p = 0; p < PATTERNS::PATTERN_COUNT; p++) {
+    benchmark.render(p, FRAME_TIME);
+    printf("%-13s ", PATTERN_NAMES[p]);
+    fflush(stdout);
+    benchmark.run(p, FRAME_TIME);
+  }
+  benchmark.runOutputStage();
+  fflush(stdout);
+  benchCrossfades();
+  benchOutputStage();
+  benchFire();
+  benchLedId();
+  return 0;
+}
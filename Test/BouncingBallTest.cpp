@@ -0,0 +1,73 @@
+/*
+ * BouncingBall's integer physics follows the original floating point model, kept here as it was:
+ * every ball stays within one led of where the float model puts it.
+ */
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "HostTest.h"
+
+//the original model of one ball, in start heights and seconds
+struct FloatBall {
+  float impactvelocity;
+  float dampening;
+  long lastbounce;
+
+  static float startVelocity() {
+    return sqrt(-2 * -9.81f * 1);
+  }
+
+  //height in leds at time now, in ms
+  float update(long now) {
+    float t = now - lastbounce;
+    float height = 0.5f * -9.81f * pow(t / 1000, 2.0f) + impactvelocity * t / 1000;
+    if(height < 0) {
+      height = 0;
+      impactvelocity = dampening * impactvelocity;
+      lastbounce = now;
+      if(impactvelocity < 0.01f) impactvelocity = startVelocity();
+    }
+    return height * (LEDS_PER_ROW - 1);
+  }
+};
+
+int main() {
+  const int ROWS_SIMULATED = BouncingBall::NOROWS;
+  const int BALLS = BouncingBall::BallCount;
+  double worst = 0;
+  for(int seed = 1; seed <= 20; seed++) {
+    //the float balls take their dampening from the same random numbers as the pattern
+    patternenvironment.seed(seed);
+    patternenvironment.setFrameTime(FRAME_MS);
+    framenumber = 0;
+    FloatBall balls[ROWS_SIMULATED][BALLS];
+    for(int row = 0; row < ROWS_SIMULATED; row++) {
+      for(int i = 0; i < BALLS; i++) {
+        balls[row][i].impactvelocity = FloatBall::startVelocity();
+        balls[row][i].dampening = 0.90f - float(patternenvironment.random16() >> 8) / 1024;
+        balls[row][i].lastbounce = 0;
+      }
+    }
+    patternenvironment.seed(seed);
+    BouncingBall pattern;
+    pattern.setup();
+    //two minutes, long enough for every ball to die down and restart several times
+    for(int frame = 1; frame <= 30 * 120; frame++) {
+      framenumber = frame;
+      pattern.update(leds);
+      long now = patternenvironment.millis();
+      for(int row = 0; row < ROWS_SIMULATED; row++) {
+        for(int i = 0; i < BALLS; i++) {
+          double expected = balls[row][i].update(now);
+          double actual = pattern.Position[row][i] / 256.0;
+          worst = max(worst, fabs(actual - expected));
+          if(!CHECK_NEAR(actual, expected, 1.0)) {
+            fprintf(stderr, "seed %d frame %d row %d ball %d\n", seed, frame, row, i);
+            return finish("BouncingBallTest");
+          }
+        }
+      }
+    }
+  }
+  printf("furthest from the float model: %.2f leds\n", worst);
+  return finish("BouncingBallTest");
+}
@@ -0,0 +1,56 @@
+/*
+ * PatternManager.h: a crossfade between two sparse patterns that fades and mixes only the blocks they wrote gives the
+ * same frames as one that processes every led, for every pair of sparse patterns.
+ */
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "HostTest.h"
+#include "PatternNames.h"
+
+//frames the first pattern runs alone, then frames past the end of the crossfade
+const int LEAD_IN = 10;
+const int TRANSITION = 90;
+
+//renders a crossfade from one pattern to another, returning the crc of its frames. Each run starts the same.
+uint16_t crossfadeCrc(int from, int to, bool skipclean) {
+  PatternManager* manager = levelmanager.getPatternManager();
+  manager->setSkipClean(skipclean);
+  framenumber = 0;
+  patternenvironment.seed(from * PATTERNS::PATTERN_COUNT + to);
+  patternenvironment.setFrameTime(FRAME_MS);
+  rand16seed = 1337;
+  srand(1);
+  fill_solid(leds, NUM_LEDS, CRGB::Black);
+  manager->jump(from);
+  uint16_t crc = 0xFFFF;
+  for(int i = 0; i < LEAD_IN + TRANSITION; i++) {
+    if(i == LEAD_IN) manager->transition(to);
+    framenumber++;
+    manager->update();
+    crc = benchmark.frameCrc(crc);
+  }
+  manager->setSkipClean(true);
+  return crc;
+}
+
+bool isSparse(int p) {
+  PatternManager* manager = levelmanager.getPatternManager();
+  manager->jump(p);
+  return dynamic_cast<SparsePattern*>(manager->getPattern()) != NULL;
+}
+
+int main() {
+  std::vector<int> sparse;
+  for(int p = 0; p < PATTERNS::PATTERN_COUNT; p++) if(isSparse(p)) sparse.push_back(p);
+  CHECK(sparse.size() >= 2);
+  for(int from : sparse) {
+    for(int to : sparse) {
+      if(from == to) continue;
+      uint16_t skipped = crossfadeCrc(from, to, true);
+      uint16_t full = crossfadeCrc(from, to, false);
+      if(!CHECK_EQUAL(skipped, full)) fprintf(stderr, "%s to %s\n", PATTERN_NAMES[from], PATTERN_NAMES[to]);
+    }
+  }
+  printf("%d sparse patterns, %d crossfades\n", int(sparse.size()), int(sparse.size() * (sparse.size() - 1)));
+  return finish("CrossfadeTest");
+}
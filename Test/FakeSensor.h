@@ -0,0 +1,41 @@
+/*
+ * Stands in for the Sensor board. When the LED board raises the frame signal, the next reading is sent on Serial3,
+ * as Sensor.ino does. Include after the sketch.
+ */
+
+class FakeSensor {
+  public:
+    //the reading sent for the next request. Its sequence number is advanced for each one sent.
+    SensorReading reading;
+    //called before answering each request, to set the reading. Returns false to leave the request unanswered.
+    std::function<bool(SensorReading&)> source;
+    //requests seen, and answered
+    unsigned long requests = 0;
+    unsigned long answers = 0;
+
+    FakeSensor() {
+      memset(&reading, 0, sizeof(reading));
+    }
+
+    //starts answering the sketch's requests
+    void attach() {
+      host::onDigitalWrite = [this](int pin, int value) {
+        if(pin == FRAME_SIGNAL_DPIN && value == HIGH) request();
+      };
+    }
+
+    void request() {
+      requests++;
+      if(source && !source(reading)) return;
+      send();
+    }
+
+    //sends the reading, whether or not it was asked for
+    void send() {
+      byte frame[SENSOR_MAX_FRAME];
+      int length = encodeSensorReading(reading, frame);
+      Serial3.feed(frame, length);
+      reading.sequence++;
+      answers++;
+    }
+};
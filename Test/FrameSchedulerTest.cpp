@@ -0,0 +1,112 @@
+/*
+ * Runs the LED sketch with extra work injected into every frame, standing in for slow patterns, and checks how
+ * FrameScheduler copes: frames are updated 30 times a second while the loop can keep up by skipping shows, no more
+ * than MAX_DROPPED_FRAMES shows are skipped in a row, and transitions and patterns timed by the clock keep their
+ * speed even when it can't.
+ */
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "HostTest.h"
+#include "FakeSensor.h"
+
+struct Result {
+  //per second of simulated time
+  double updates;
+  double shows;
+  unsigned int resyncs;
+  //most shows skipped in a row
+  int maxskipped;
+  //simulated time a transition took, in ms
+  double transitionms;
+  //Pattern::frames() counted per second
+  double patternframes;
+};
+
+//runs for a simulated 20 seconds with load microseconds of extra work each frame
+Result run(unsigned long load) {
+  host::now = 0;
+  framenumber = 0;
+  framescheduler = FrameScheduler();
+  //the sketch's patterns follow the real clock
+  patternenvironment.setFrameTime(0);
+  FakeSensor sensor;
+  sensor.attach();
+  //the work happens as the frame starts, when the sketch checks for the sensor's reading
+  long loaded = -1;
+  Serial3.onAvailable = [&]() {
+    if(loaded == framenumber) return;
+    loaded = framenumber;
+    host::advance(load);
+  };
+  setup();
+  PatternManager* patternmanager = levelmanager.getPatternManager();
+
+  Result result;
+  uint64_t start = host::now;
+  unsigned long shows = host::shows;
+  long frames = framenumber;
+  long patternstart = Pattern::frames();
+  int skipped = 0;
+  result.maxskipped = 0;
+  result.transitionms = 0;
+  uint64_t transitionstart = 0;
+  while(host::now - start < 20000000ULL) {
+    //start a transition 5 seconds in, and time it
+    if(!transitionstart && host::now - start > 5000000ULL) {
+      patternmanager->transition(PATTERNS::FIRE);
+      transitionstart = host::now;
+    }
+    unsigned long before = host::shows;
+    loop();
+    skipped = host::shows == before ? skipped + 1 : 0;
+    result.maxskipped = max(result.maxskipped, skipped);
+    if(transitionstart && !result.transitionms && !patternmanager->nextpattern) {
+      result.transitionms = (host::now - transitionstart) / 1000.0;
+    }
+  }
+  double seconds = (host::now - start) / 1e6;
+  result.updates = (framenumber - frames) / seconds;
+  result.shows = (host::shows - shows) / seconds;
+  result.resyncs = framescheduler.getResyncs();
+  result.patternframes = (Pattern::frames() - patternstart) / seconds;
+  Serial3.onAvailable = NULL;
+  printf("load %2lums: %.1f updates/s, %.1f shows/s, %u resyncs, %d skipped in a row, transition %.0fms\n",
+         load / 1000, result.updates, result.shows, result.resyncs, result.maxskipped, result.transitionms);
+  return result;
+}
+
+int main() {
+  host::showtime = showTimeUs(false);
+  const double FRAME_RATE = 1000.0 / FRAME_MS;
+  const double TRANSITION_MS = levelmanager.getPatternManager()->TRANSITION_FRAMES * FRAME_MS;
+
+  //light load: every frame is shown
+  Result light = run(5000);
+  CHECK_NEAR(light.updates, FRAME_RATE, 0.5);
+  CHECK_NEAR(light.shows, FRAME_RATE, 0.5);
+  CHECK_EQUAL(light.maxskipped, 0);
+
+  //the frame and the show no longer fit, some shows are skipped so every frame is still updated on time
+  Result heavy = run(25000);
+  CHECK_NEAR(heavy.updates, FRAME_RATE, 0.5);
+  CHECK(heavy.shows < FRAME_RATE * 0.75);
+  CHECK(heavy.shows > FRAME_RATE / (MAX_DROPPED_FRAMES + 1) - 0.5);
+  CHECK(heavy.maxskipped <= MAX_DROPPED_FRAMES);
+  CHECK_EQUAL(heavy.resyncs, 0);
+
+  //the frame alone takes longer than FRAME_MS, so updates slow down and the scheduler gives up catching up
+  Result overload = run(40000);
+  CHECK(overload.updates < FRAME_RATE * 0.8);
+  CHECK(overload.maxskipped <= MAX_DROPPED_FRAMES);
+  CHECK(overload.resyncs > 0);
+
+  //whatever the load, patterns timed by the clock, and transitions, keep their speed
+  Result results[] = {light, heavy, overload};
+  for(Result& result : results) {
+    CHECK_NEAR(result.patternframes, FRAME_RATE, 0.5);
+    //the transition is seen to end a frame after it's due, give or take a frame
+    double frame = 1000.0 / result.updates;
+    CHECK_NEAR(result.transitionms, TRANSITION_MS + frame, frame);
+  }
+  return finish("FrameSchedulerTest");
+}
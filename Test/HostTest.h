@@ -0,0 +1,43 @@
+/*
+ * Checks for the host tests. Each test is a program built against the shim in shim/, returning non-zero
+ * if any check failed. A failed check is reported and the test carries on, so one run shows every failure.
+ */
+
+int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+//for values, reports both sides when they differ
+#define CHECK_EQUAL(a, b) checkEqual((long long)(a), (long long)(b), #a " == " #b, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tolerance) checkNear((a), (b), (tolerance), #a " ~ " #b, __FILE__, __LINE__)
+
+bool check(bool ok, const char* text, const char* file, int line) {
+  if(!ok) {
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, text);
+    failures++;
+  }
+  return ok;
+}
+
+bool checkEqual(long long a, long long b, const char* text, const char* file, int line) {
+  if(a != b) {
+    fprintf(stderr, "%s:%d: check failed: %s (%lld != %lld)\n", file, line, text, a, b);
+    failures++;
+  }
+  return a == b;
+}
+
+bool checkNear(double a, double b, double tolerance, const char* text, const char* file, int line) {
+  bool ok = fabs(a - b) <= tolerance;
+  if(!ok) {
+    fprintf(stderr, "%s:%d: check failed: %s (%g vs %g, tolerance %g)\n", file, line, text, a, b, tolerance);
+    failures++;
+  }
+  return ok;
+}
+
+//call at the end of main()
+int finish(const char* name) {
+  if(failures) fprintf(stderr, "%s: %d checks failed\n", name, failures);
+  else printf("%s: passed\n", name);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * Audio.h and Console.h: the sound levels move between each pair of levels after the configured threshold,
+ * hysteresis and duration, for the default config and others, and invalid configs are rejected with their reason,
+ * leaving the last good config in use.
+ */
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "HostTest.h"
+
+//holds the model's audio level for a number of seconds, one update a frame. Returns the ms from the start until the
+//level changed, or -1 if it didn't. The wait starts on the first update and ends on the first update after it, so a
+//change comes up to two frames after its duration.
+long hold(SoundReactor& reactor, int audiolevel, long seconds) {
+  unsigned int start = reactor.getLevel();
+  unsigned long started = millis();
+  for(long frame = 0; frame < seconds * 1000 / FRAME_MS; frame++) {
+    host::advance(FRAME_MS * 1000UL);
+    reactor.audiolevel = long(audiolevel) << 8;
+    reactor.updateLevel();
+    if(reactor.getLevel() != start) return millis() - started;
+  }
+  return -1;
+}
+
+bool changedAfter(long waited, int seconds) {
+  return CHECK(waited > seconds * 1000L && waited <= seconds * 1000L + 2 * FRAME_MS + 1);
+}
+
+//moves up from level 0 and back down again, one boundary at a time. Each change waits out its duration, and
+//a level just inside the hysteresis doesn't change at all.
+void climb(SoundReactor& reactor, const char* name) {
+  LevelConfig config = reactor.getConfig();
+  hold(reactor, 0, 255 * (MAX_LEVELS - 1));
+  CHECK_EQUAL(reactor.getLevel(), 0);
+  for(int i = 0; i < config.levels - 1; i++) {
+    int above = config.threshold[i] + config.positive_hysteresis[i];
+    CHECK_EQUAL(hold(reactor, above, config.duration_positive[i] + 2), -1);
+    long waited = hold(reactor, above + 1, config.duration_positive[i] + 2);
+    if(!changedAfter(waited, config.duration_positive[i])) fprintf(stderr, "%s, up %d\n", name, i);
+    CHECK_EQUAL(reactor.getLevel(), i + 1);
+  }
+  for(int i = config.levels - 2; i >= 0; i--) {
+    int below = config.threshold[i] - config.negative_hysteresis[i];
+    CHECK_EQUAL(hold(reactor, below, config.duration_negative[i] + 2), -1);
+    long waited = hold(reactor, below - 1, config.duration_negative[i] + 2);
+    if(!changedAfter(waited, config.duration_negative[i])) fprintf(stderr, "%s, down %d\n", name, i);
+    CHECK_EQUAL(reactor.getLevel(), i);
+  }
+}
+
+void testDefaults() {
+  SoundReactor reactor;
+  CHECK_EQUAL(reactor.getConfig().levels, 3);
+  CHECK_EQUAL(reactor.getLevel(), 1);
+  climb(reactor, "defaults");
+  //the original quiet, medium and loud timings
+  CHECK_EQUAL(hold(reactor, 51, 3) / 1000, 2);
+  CHECK_EQUAL(hold(reactor, 76, 11) / 1000, 10);
+  CHECK_EQUAL(hold(reactor, 69, 31) / 1000, 30);
+}
+
+//a level that dips back before its duration is up starts waiting again
+void testInterrupted() {
+  SoundReactor reactor;
+  CHECK_EQUAL(hold(reactor, 80, 9), -1);
+  CHECK_EQUAL(hold(reactor, 60, 1), -1);
+  changedAfter(hold(reactor, 80, 11), 10);
+}
+
+void testConfigs() {
+  LevelConfig config;
+  //two levels, with hysteresis both ways
+  config.setDefaults();
+  config.levels = 2;
+  config.setBoundary(0, 100, 10, 20, 5, 3);
+  SoundReactor two;
+  CHECK(two.setConfig(config) == NULL);
+  climb(two, "two levels");
+
+  //the most levels, close together
+  config.setDefaults();
+  config.setLevels(MAX_LEVELS);
+  for(int i = 0; i < MAX_LEVELS - 1; i++) config.setBoundary(i, 40 + i * 12, 2, 3, 1 + i, 6 - i);
+  SoundReactor six;
+  CHECK(six.setConfig(config) == NULL);
+  climb(six, "six levels");
+
+  //a single level never changes
+  config.setDefaults();
+  config.setLevels(1);
+  SoundReactor one;
+  CHECK(one.setConfig(config) == NULL);
+  CHECK_EQUAL(one.getLevel(), 0);
+  CHECK_EQUAL(hold(one, 1023, 60), -1);
+  CHECK_EQUAL(hold(one, 0, 60), -1);
+
+  //new boundaries added by setLevels() are usable straight away
+  config.setDefaults();
+  config.setLevels(5);
+  SoundReactor added;
+  CHECK(added.setConfig(config) == NULL);
+  climb(added, "added levels");
+}
+
+//each broken config is rejected with its reason, and the model carries on with the config it had
+void testRejected() {
+  struct Case {
+    const char* reason;
+    std::function<void(LevelConfig&)> breakit;
+  };
+  const Case cases[] = {
+    {"bad magic", [](LevelConfig& c) { c.magic++; }},
+    {"level count out of range", [](LevelConfig& c) { c.levels = 0; }},
+    {"level count out of range", [](LevelConfig& c) { c.levels = MAX_LEVELS + 1; }},
+    {"threshold below 0", [](LevelConfig& c) { c.setBoundary(0, 5, 6, 5, 30, 2); }},
+    {"threshold above 1023", [](LevelConfig& c) { c.setBoundary(1, 1020, 0, 5, 30, 10); }},
+    {"thresholds must increase", [](LevelConfig& c) { c.setBoundary(1, 45, 0, 5, 30, 10); }},
+    {"durations must be at least 1s", [](LevelConfig& c) { c.duration_negative[0] = 0; }},
+    {"durations must be at least 1s", [](LevelConfig& c) { c.duration_positive[1] = 0; }},
+  };
+  for(const Case& test : cases) {
+    SoundReactor reactor;
+    hold(reactor, 80, 11);
+    CHECK_EQUAL(reactor.getLevel(), 2);
+    LevelConfig config;
+    config.setDefaults();
+    test.breakit(config);
+    const __FlashStringHelper* error = reactor.setConfig(config);
+    if(!CHECK(error && !strcmp((const char*)error, test.reason))) {
+      fprintf(stderr, "expected \"%s\", got \"%s\"\n", test.reason, error ? (const char*)error : "accepted");
+    }
+    CHECK_EQUAL(reactor.getLevel(), 2);
+    CHECK_EQUAL(reactor.getConfig().levels, 3);
+    CHECK_EQUAL(reactor.getConfig().threshold[1], 70);
+  }
+  //boundaries past the level count aren't checked
+  LevelConfig config;
+  config.setDefaults();
+  config.levels = 2;
+  config.setBoundary(1, 0, 0, 0, 0, 0);
+  SoundReactor reactor;
+  CHECK(reactor.setConfig(config) == NULL);
+}
+
+//fewer levels move the current level down to the new top level
+void testFewerLevels() {
+  SoundReactor reactor;
+  hold(reactor, 80, 11);
+  CHECK_EQUAL(reactor.getLevel(), 2);
+  LevelConfig config = reactor.getConfig();
+  config.setLevels(2);
+  CHECK(reactor.setConfig(config) == NULL);
+  CHECK_EQUAL(reactor.getLevel(), 1);
+  CHECK_EQUAL(hold(reactor, 80, 11), -1);
+  CHECK(hold(reactor, 40, 31) > 0);
+  CHECK_EQUAL(reactor.getLevel(), 0);
+}
+
+//sends a line to the console, returning what it printed
+std::string command(const char* line) {
+  Serial.take();
+  Serial.feed(line);
+  Serial.feed("\n");
+  console.update();
+  return Serial.take();
+}
+
+bool starts(const std::string& text, const char* prefix) {
+  return !text.compare(0, strlen(prefix), prefix);
+}
+
+void testConsole() {
+  CHECK(starts(command("levels"), "levels 3\r\nlevel 0 45 0 5 30 2\r\nlevel 1 70 0 5 30 10\r\n"));
+  CHECK(starts(command("level 1 90 4 6 20 5"), "levels 3\r\n"));
+  CHECK_EQUAL(soundlevel.getConfig().threshold[1], 90);
+  CHECK_EQUAL(soundlevel.getConfig().duration_positive[1], 5);
+  CHECK(starts(command("level 1 40 0 5 30 10"), "error: thresholds must increase"));
+  CHECK(starts(command("level 2 90 0 5 30 10"), "error: no such level boundary"));
+  CHECK(starts(command("level -1 90 0 5 30 10"), "error: no such level boundary"));
+  CHECK(starts(command("level 0 2000 0 5 30 10"), "error: threshold above 1023"));
+  CHECK(starts(command("level 0 45 0 5 0 2"), "error: durations must be at least 1s"));
+  CHECK(starts(command("levels 0"), "error: level count out of range"));
+  CHECK(starts(command("levels 7"), "error: level count out of range"));
+  CHECK(starts(command("level 0 x 0 5 30 2"), "error: expected a number"));
+  CHECK(starts(command("level 0 45 0 5 30 2 1"), "error: too many arguments"));
+  CHECK(starts(command("level 0 45"), "error: unknown command"));
+  //none of the rejected edits changed anything
+  CHECK_EQUAL(soundlevel.getConfig().levels, 3);
+  CHECK_EQUAL(soundlevel.getConfig().threshold[0], 45);
+  CHECK_EQUAL(soundlevel.getConfig().threshold[1], 90);
+
+  //kept over a reboot once saved, and only then
+  CHECK(starts(command("levels 4"), "levels 4\r\n"));
+  CHECK(starts(command("save"), "saved"));
+  CHECK(starts(command("level 2 150 0 5 30 10"), "levels 4\r\n"));
+  SoundReactor rebooted;
+  rebooted.setup();
+  CHECK_EQUAL(rebooted.getConfig().levels, 4);
+  CHECK_EQUAL(rebooted.getConfig().threshold[1], 90);
+  CHECK_EQUAL(rebooted.getConfig().threshold[2], 100);
+  CHECK(starts(command("defaults"), "levels 3\r\n"));
+  CHECK_EQUAL(soundlevel.getConfig().threshold[1], 70);
+
+  //a corrupted store falls back to the defaults
+  EEPROM.data[LEVEL_CONFIG_ADDRESS + 4] ^= 1;
+  SoundReactor corrupted;
+  corrupted.setup();
+  CHECK_EQUAL(corrupted.getConfig().levels, 3);
+  CHECK_EQUAL(corrupted.getConfig().threshold[1], 70);
+}
+
+int main() {
+  testDefaults();
+  testInterrupted();
+  testConfigs();
+  testRejected();
+  testFewerLevels();
+  testConsole();
+  return finish("LevelConfigTest");
+}
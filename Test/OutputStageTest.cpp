@@ -0,0 +1,87 @@
+/*
+ * OutputStage.h's power model and limiter, through every phase of LoadTest at full brightness: the per segment
+ * estimate gathered while converting matches a per led reference model, every segment stays under its fuse rating,
+ * and an overall limit holds the total under it.
+ */
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "HostTest.h"
+
+//5V supply, for the error in watts
+const double VOLTS = 5;
+
+//the reference: each led's channels at their full brightness current, plus its dark current, in mA
+double referenceMilliamps(const CRGB ledbuffer[], int first, int last) {
+  double current = 0;
+  for(int i = first; i < last; i++) {
+    current += (ledbuffer[i].r * RED_MA + ledbuffer[i].g * GREEN_MA + ledbuffer[i].b * BLUE_MA) / 255.0 + DARK_MA;
+  }
+  return current;
+}
+
+//frames LoadTest takes to reach its last phase, kept on for a few seconds after
+long loadTestFrames() {
+  return NUM_LEDS * 3 + 30 * 60 + 30 * 5 + 30 * 5;
+}
+
+//runs LoadTest through the output stage, with an overall limit in mA or 0 for none
+void testLoad(long limit) {
+  OutputStage stage, unlimitedstage;
+  stage.setBrightness(255);
+  stage.setPowerLimit(limit);
+  unlimitedstage.setBrightness(255);
+  static CRGB unlimitedleds[NUM_LEDS];
+  loadtest.setup();
+  double worsterror = 0, peaksegment = 0, peaktotal = 0;
+  long limited = 0;
+  for(long frame = 1; frame <= loadTestFrames(); frame++) {
+    framenumber = frame;
+    loadtest.update(leds);
+    memcpy(unlimitedleds, leds, sizeof(leds));
+    unlimitedstage.apply(unlimitedleds);
+    stage.apply(leds);
+    double total = 0;
+    for(int segment = 0; segment < POWER_SEGMENTS; segment++) {
+      double reference = referenceMilliamps(leds, segmentstart(segment), segmentstart(segment + 1));
+      double error = fabs(stage.getMilliamps(segment) - reference);
+      worsterror = max(worsterror, error);
+      peaksegment = max(peaksegment, reference);
+      total += reference;
+      //the estimate only loses the fraction of a mA it rounds down
+      if(!CHECK(error < 1)) fprintf(stderr, "frame %ld, segment %d\n", frame, segment);
+      if(!CHECK(reference < SEGMENT_LIMIT_MA)) fprintf(stderr, "frame %ld, segment %d\n", frame, segment);
+    }
+    peaktotal = max(peaktotal, total);
+    if(memcmp(leds, unlimitedleds, sizeof(leds))) limited++;
+    CHECK_NEAR(stage.getTotalMilliamps(), total, POWER_SEGMENTS);
+    if(limit > 0 && !CHECK(total < limit)) fprintf(stderr, "frame %ld\n", frame);
+  }
+  printf("limit %ldmA: peak %.0fmA, %.0fmA per segment, %ld frames limited, estimate within %.2fmA (%.4fW)\n",
+         limit, peaktotal, peaksegment, limited, worsterror, worsterror * VOLTS / 1000);
+  //full white takes more than 15A, so the overall limit is used
+  if(limit > 0) CHECK(limited > 0);
+  else CHECK_EQUAL(limited, 0);
+}
+
+//the soft limit leaves currents up to 3/4 of the limit alone, and keeps anything above it under the limit,
+//for any segment size
+void testSoftLimit() {
+  for(int count : {1, 120, 300, NUM_LEDS}) {
+    for(long limit : {2000L, SEGMENT_LIMIT_MA, 15000L}) {
+      long dark = long(count) * DARK_MA;
+      for(long current = dark; current <= 60000; current += 7) {
+        int scale = softLimitScale(current, limit, count);
+        long scaled = dark + (current - dark) * scale / 256;
+        if(current <= limit * 3 / 4) CHECK_EQUAL(scale, 256);
+        else if(!CHECK(scaled < limit || scale == 0)) fprintf(stderr, "%d leds, %ldmA of %ldmA\n", count, current, limit);
+      }
+    }
+  }
+}
+
+int main() {
+  testLoad(0);
+  testLoad(15000);
+  testSoftLimit();
+  return finish("OutputStageTest");
+}
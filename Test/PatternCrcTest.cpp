@@ -0,0 +1,38 @@
+/*
+ * Renders every pattern as BENCHMARK does, and compares the crc of its frames with the one stored in
+ * golden/<pattern>.crc, named as in PatternNames.h. A change that should not alter a pattern's output must leave
+ * every crc unchanged.
+ * When output changes on purpose, `make golden` stores the new crcs, to be reviewed and committed with it.
+ */
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "HostTest.h"
+#include "PatternNames.h"
+
+int main(int argc, char** argv) {
+  //with --update, writes the crcs instead of checking them
+  bool update = argc > 1 && !strcmp(argv[1], "--update");
+  for(int p = 0; p < PATTERNS::PATTERN_COUNT; p++) {
+    uint16_t crc = benchmark.render(p, FRAME_TIME);
+    char path[64];
+    snprintf(path, sizeof(path), "golden/%s.crc", PATTERN_NAMES[p]);
+    if(update) {
+      FILE* file = fopen(path, "w");
+      if(!check(file != NULL, path, __FILE__, __LINE__)) continue;
+      fprintf(file, "%04X\n", crc);
+      fclose(file);
+      continue;
+    }
+    unsigned int golden;
+    FILE* file = fopen(path, "r");
+    if(!file || fscanf(file, "%x", &golden) != 1) {
+      fprintf(stderr, "%s: missing, run make golden\n", path);
+      failures++;
+    } else if(golden != crc) {
+      fprintf(stderr, "%s: crc %04X, expected %04X\n", PATTERN_NAMES[p], crc, golden);
+      failures++;
+    }
+    if(file) fclose(file);
+  }
+  return finish("PatternCrcTest");
+}
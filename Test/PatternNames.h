@@ -0,0 +1,10 @@
+/*
+ * Name of each pattern, in the order of PATTERNS::PATTERN. Include after the sketch.
+ */
+const char* const PATTERN_NAMES[] = {
+  "BLANK", "ORNAMENTS", "CHASE1", "CHASE2", "FLASHROW", "FLASHRING", "RADIO", "EYE", "FIRE", "BOUNCINGBALL",
+  "LOUDNESS", "FALLINGSTAR", "SPARKLE", "WIGGLE", "DIAGONAL", "FIREWORKS", "ALTSTRIPES", "SWIRLPAINT",
+  "TESTPATTERN"
+};
+static_assert(sizeof(PATTERN_NAMES) / sizeof(PATTERN_NAMES[0]) == PATTERNS::PATTERN_COUNT,
+              "PATTERN_NAMES must list every pattern");
@@ -0,0 +1,138 @@
+/*
+ * PatternManager.h: three simulated hours of random level changes and beats, with the playlists following the
+ * original switch based LevelManager, kept here as it was. Each pattern change falls due on the same frame as the
+ * original's, and is made on the first beat within MAX_BEAT_WAIT frames, or at the end of the wait.
+ */
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "HostTest.h"
+
+//the original pattern choice, without the pattern manager it drove
+class SwitchLevelManager {
+  public:
+    const int FRAMES_PER_PATTERN = 30*60;
+    int patternset = 1;
+    //an int wrapped after 18 minutes at one level on the board, which was never intended
+    int32_t framessincelevelchange = 0;
+
+    //the pattern to change to this frame, or -1 if no change is due
+    int update() {
+      int pattern = -1;
+      if(framessincelevelchange % int(FRAMES_PER_PATTERN)==0) pattern = getnewpattern();
+      framessincelevelchange++;
+      return pattern;
+    }
+
+    PATTERNS::PATTERN getnewpattern() {
+      int patterncount = framessincelevelchange / FRAMES_PER_PATTERN;
+      switch (patternset) {
+        case 0:
+          switch (patterncount % 1) {
+            case 0:
+              return PATTERNS::EYE;
+          }; break;
+        case 1:
+          switch (patterncount % 4) {
+            case 0:
+              return PATTERNS::ORNAMENTS;
+            case 1:
+              return PATTERNS::FALLINGSTAR;
+            case 2:
+              return PATTERNS::DIAGONAL;
+            case 3:
+              return PATTERNS::SWIRLPAINT;
+          }; break;
+        case 2:
+          switch (patterncount % 7) {
+            case 0:
+              return PATTERNS::RADIO;
+            case 1:
+              return PATTERNS::FIRE;
+            case 2:
+              return PATTERNS::CHASE1;
+            case 3:
+              return PATTERNS::BOUNCINGBALL;
+            case 4:
+              return PATTERNS::LOUDNESS;
+            case 5:
+              return PATTERNS::SPARKLE;
+            case 6:
+              return PATTERNS::FIREWORKS;
+          }; break;
+      }
+      return PATTERNS::BLANK;
+    }
+
+    void newlevel(int level) {
+      patternset = level;
+      framessincelevelchange = 0;
+    }
+};
+
+//repeatable noise, so a failure can be reproduced
+uint32_t noise = 7;
+long randomBetween(long low, long high) {
+  noise = noise * 1103515245 + 12345;
+  return low + long((noise >> 8) % uint32_t(high - low + 1));
+}
+
+const long SECOND = 1000 / FRAME_MS;
+
+int main() {
+  const int MAX_BEAT_WAIT = levelmanager.MAX_BEAT_WAIT;
+  patternenvironment.setFrameTime(FRAME_MS);
+  framenumber = 0;
+  LevelManager levels;
+  levels.setup();
+  SwitchLevelManager original;
+
+  //the original's pattern at the last change that fell due, waiting for a beat
+  int pending = -1;
+  long due = 0;
+  int expected = PATTERNS::BLANK;
+  long changes = 0, onbeat = 0, waitedout = 0, superseded = 0, levelchanges = 0;
+  long nextlevel = 0;
+  for(long frame = 1; frame <= 3 * 3600 * SECOND; frame++) {
+    framenumber = frame;
+    //five seconds to ten minutes at a level, sometimes changing again before a pattern change is made
+    if(frame >= nextlevel) {
+      int level = randomBetween(0, 2);
+      levels.newlevel(level);
+      original.newlevel(level);
+      levelchanges++;
+      nextlevel = frame + (randomBetween(0, 4) ? randomBetween(5, 10 * 60) : randomBetween(1, 3)) * SECOND;
+    }
+    //a beat every three seconds on average, so some changes wait out MAX_BEAT_WAIT
+    bool beat = randomBetween(0, 89) == 0;
+    if(beat) beatdetector.beatframe = framenumber;
+
+    int pattern = original.update();
+    if(pattern >= 0) {
+      if(pending >= 0) superseded++;
+      pending = pattern;
+      due = frame;
+    }
+    //the change is made on a beat, or once the wait is over
+    if(pending >= 0 && (beat || frame - due >= MAX_BEAT_WAIT)) {
+      if(beat) onbeat++;
+      else waitedout++;
+      expected = pending;
+      pending = -1;
+    }
+
+    PATTERNS::PATTERN before = levels.currentpattern;
+    levels.update();
+    if(levels.currentpattern != before) changes++;
+    if(!CHECK_EQUAL(levels.currentpattern, expected)) {
+      fprintf(stderr, "frame %ld, level %d, due at %ld\n", frame, original.patternset, due);
+      break;
+    }
+  }
+  //levels past the playlists use the loudest one
+  levels.newlevel(5);
+  levels.update();
+  CHECK_EQUAL(levels.getnewpattern(), PATTERNS::RADIO);
+  printf("%ld level changes, %ld pattern changes, %ld made on a beat, %ld after waiting, %ld superseded while waiting\n",
+         levelchanges, changes, onbeat, waitedout, superseded);
+  return finish("PlaylistTest");
+}
@@ -0,0 +1,79 @@
+/*
+ * Renders the show on a PC, far faster than real time, for previewing patterns and playlists without the tree.
+ * Runs the LED sketch with FRAME_EXPORT on, against a fake Sensor board playing synthetic sound or a log recorded
+ * by Tools/sensorlog.py, and writes the frame export stream to stdout for Tools/frames.py to draw:
+ *
+ *   make -C Test render
+ *   Test/build/Render [seconds] [every] [sensor.log] | Tools/frames.py - outdir
+ *
+ * seconds defaults to 60, and one frame in every `every` is kept (default 1), so an hour can be skimmed.
+ * Without a log the sound cycles through quiet, medium and loud every four minutes, with a beat when loud.
+ */
+#define FRAME_EXPORT true
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "FakeSensor.h"
+#include "SensorLog.h"
+
+//seconds of each part of the synthetic sound cycle
+#define QUIET_SECONDS  60
+#define MEDIUM_SECONDS 60
+#define LOUD_SECONDS   120
+//frames between beats when loud, 120 bpm
+#define BEAT_FRAMES    15
+
+//synthetic sound for a frame: a steady level for each part of the cycle, with noise and beats
+bool synthetic(SensorReading& reading, long frame) {
+  long second = frame / 30 % (QUIET_SECONDS + MEDIUM_SECONDS + LOUD_SECONDS);
+  int level = second < QUIET_SECONDS ? 20 : second < QUIET_SECONDS + MEDIUM_SECONDS ? 60 : 95;
+  if(second >= QUIET_SECONDS + MEDIUM_SECONDS && frame % BEAT_FRAMES == 0) level += 60;
+  reading.audiolevel = level + rand() % 10;
+  reading.lightlevel = 20;
+  return true;
+}
+
+int main(int argc, char** argv) {
+  long seconds = argc > 1 ? atol(argv[1]) : 60;
+  long every = argc > 2 ? atol(argv[2]) : 1;
+  FILE* log = NULL;
+  if(argc > 3 && !(log = fopen(argv[3], "rb"))) {
+    perror(argv[3]);
+    return 1;
+  }
+  if(seconds <= 0 || every <= 0) {
+    fprintf(stderr, "usage: %s [seconds] [every] [sensor.log]\n", argv[0]);
+    return 1;
+  }
+
+  //busy waits only need to see time pass, a coarse clock makes them quick
+  host::clockcost = 20;
+  host::showtime = showTimeUs(false);
+  srand(1);
+  FakeSensor sensor;
+  SensorLog records(log);
+  bool logended = false;
+  if(!log) {
+    sensor.source = [](SensorReading& reading) { return synthetic(reading, framenumber); };
+    sensor.attach();
+  }
+
+  Serial.sink = stdout;
+  setup();
+  for(long frame = 1; frame <= seconds * 1000 / FRAME_MS; frame++) {
+    //frames that aren't kept are discarded with any other output
+    Serial.sink = frame % every == 0 ? stdout : NULL;
+    //a log is played one record a frame, sent ahead of the frame's poll, whatever the sketch asked for. A frame
+    //logged without a reading sends nothing, without shifting the rest of the log. Once it ends, the sensor goes quiet.
+    if(log && !logended) {
+      int type = records.next(sensor.reading);
+      if(type == 0) logended = true;
+      if(type == SENSOR_LOG_READING) sensor.send();
+    }
+    loop();
+    Serial.output.clear();
+  }
+  fflush(stdout);
+  if(logended) fprintf(stderr, "sensor log ended after %lu records\n", records.records);
+  fprintf(stderr, "%ld frames rendered, %.1f simulated seconds\n", framenumber, host::now / 1e6);
+  return 0;
+}
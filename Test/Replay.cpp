@@ -0,0 +1,57 @@
+/*
+ * Plays a log recorded by Tools/sensorlog.py through the LED sketch on a PC, with SENSOR_SOURCE set to
+ * SENSOR_REPLAY, and prints what the sketch made of it once a second: the loudest audio level received, the level
+ * model's smoothed audio level, the sound level it chose, and the pattern shown. Answers each request the sketch
+ * makes with the next record, as sensorlog.py replay does for the board.
+ *
+ *   make -C Test replay
+ *   Test/build/Replay party.log
+ */
+#define SENSOR_SOURCE SENSOR_REPLAY
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "PatternNames.h"
+#include "SensorLog.h"
+
+//answers each request written since the last call with the next record. Returns false at the end of the log.
+bool answer(SensorLog& log) {
+  std::string written = Serial.take();
+  for(size_t i = 0; i < written.size(); i++) {
+    if(byte(written[i]) != SENSOR_LOG_REQUEST) continue;
+    byte record[4];
+    int length = log.next(record);
+    if(length == 0) return false;
+    Serial.feed(record, length);
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if(argc != 2) {
+    fprintf(stderr, "usage: %s sensor.log\n", argv[0]);
+    return 1;
+  }
+  FILE* file = fopen(argv[1], "rb");
+  if(!file) {
+    perror(argv[1]);
+    return 1;
+  }
+  SensorLog log(file);
+  host::clockcost = 20;
+  host::showtime = showTimeUs(false);
+
+  setup();
+  printf("%6s %6s %6s %6s %s\n", "second", "audio", "model", "level", "pattern");
+  unsigned int loudest = 0;
+  while(answer(log)) {
+    loop();
+    loudest = max(loudest, sensorlink.getAudioLevel());
+    if(framenumber % 30 == 0) {
+      printf("%6ld %6u %6u %6u %s\n", framenumber / 30, loudest, soundlevel.getAudioLevel(), soundlevel.getLevel(),
+             PATTERN_NAMES[levelmanager.currentpattern]);
+      loudest = 0;
+    }
+  }
+  printf("%lu records, %u timeouts\n", log.records, sensorlink.getTimeouts());
+  return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * SampleRing.h and Common.h's MinMax: synthetic waveforms pushed by a simulated ADC interrupt come out of the ring in
+ * order across many wrap-arounds, MinMax measures their range, and a reader held up for the time it takes to send a
+ * reading loses exactly the samples the ring can't hold.
+ */
+#include <Arduino.h>
+#include "../Sensor/Common.h"
+#include "../Sensor/SensorProtocol.h"
+#include "../Sensor/SampleRing.h"
+#include "HostTest.h"
+
+//free running ADC rate, see AudioSampler.h
+const double SAMPLE_RATE = 19200;
+//Sensor.ino's SENSOR_BAUD
+const long BAUD = 38400;
+//samples the ring holds, one slot is kept free to tell full from empty
+const int CAPACITY = SAMPLE_BUFFER_SIZE - 1;
+
+//a waveform's sample n, in ADC counts
+typedef std::function<int(long n)> Wave;
+
+Wave sine(double frequency, int amplitude) {
+  return [=](long n) {
+    return 512 + int(lround(amplitude * sin(2 * M_PI * frequency * n / SAMPLE_RATE)));
+  };
+}
+
+Wave square(double frequency, int low, int high) {
+  return [=](long n) {
+    return fmod(frequency * n / SAMPLE_RATE, 1.0) < 0.5 ? high : low;
+  };
+}
+
+//pushes count samples of the wave, draining the ring every batch samples as the main loop would. The samples come
+//out in the order they went in, and MinMax sees each one.
+void stream(const Wave& wave, long count, int batch, int expectedrange, const char* name) {
+  SampleRing ring;
+  MinMax minmax;
+  long popped = 0;
+  int sample;
+  for(long n = 0; n < count; n++) {
+    ring.push(wave(n));
+    if((n + 1) % batch) continue;
+    while(ring.pop(sample)) {
+      if(!CHECK_EQUAL(sample, wave(popped))) {
+        fprintf(stderr, "%s, sample %ld\n", name, popped);
+        return;
+      }
+      minmax.update(sample);
+      popped++;
+    }
+  }
+  while(ring.pop(sample)) {
+    CHECK_EQUAL(sample, wave(popped));
+    minmax.update(sample);
+    popped++;
+  }
+  CHECK_EQUAL(popped, count);
+  CHECK_EQUAL(ring.getOverflows(), 0);
+  CHECK_EQUAL(minmax.getSamples(), count);
+  if(!CHECK_EQUAL(minmax.getRange(), expectedrange)) fprintf(stderr, "%s\n", name);
+}
+
+//a batch as large as the ring, and one that doesn't divide it, so the indices wrap at every position
+void testStreams() {
+  stream(sine(440, 300), 19200, CAPACITY, 600, "440Hz sine");
+  stream(sine(50, 511), 19200, 37, 1022, "50Hz full scale sine");
+  stream(sine(3000, 20), 5000, 1, 40, "quiet 3kHz sine");
+  stream(square(100, 200, 900), 19200, 45, 700, "100Hz square");
+  stream(square(1000, 0, 1023), 7777, 63, 1023, "1kHz clipped square");
+}
+
+//the ring fills to CAPACITY, and the next sample is dropped and counted
+void testFull() {
+  SampleRing ring;
+  for(int i = 0; i < CAPACITY; i++) ring.push(i);
+  CHECK_EQUAL(ring.getOverflows(), 0);
+  ring.push(999);
+  CHECK_EQUAL(ring.getOverflows(), 1);
+  int sample;
+  for(int i = 0; i < CAPACITY; i++) {
+    CHECK(ring.pop(sample));
+    CHECK_EQUAL(sample, i);
+  }
+  CHECK(!ring.pop(sample));
+  //room again once read
+  ring.push(5);
+  CHECK(ring.pop(sample));
+  CHECK_EQUAL(sample, 5);
+  CHECK_EQUAL(ring.getOverflows(), 1);
+}
+
+//the main loop doesn't read while it sends a reading. Over that time the interrupt converts more samples than the ring
+//holds, so the ones after CAPACITY are dropped, and reading resumes with the oldest.
+void testStalled() {
+  SensorReading reading = SensorReading();
+  byte frame[SENSOR_MAX_FRAME];
+  int length = encodeSensorReading(reading, frame);
+  //a start and stop bit for each byte
+  double transmit = length * 10.0 / BAUD;
+  long stalled = lround(transmit * SAMPLE_RATE);
+  printf("a %d byte reading takes %.2fms to send, %ld samples\n", length, transmit * 1000, stalled);
+  CHECK(stalled > CAPACITY);
+
+  Wave wave = sine(440, 300);
+  SampleRing ring;
+  MinMax minmax;
+  int sample;
+  //part way round, so the stall wraps the indices
+  for(long n = 0; n < 40; n++) {
+    ring.push(wave(n));
+    CHECK(ring.pop(sample));
+  }
+  for(long n = 40; n < 40 + stalled; n++) ring.push(wave(n));
+  CHECK_EQUAL(ring.getOverflows(), stalled - CAPACITY);
+  long n = 40;
+  while(ring.pop(sample)) {
+    CHECK_EQUAL(sample, wave(n++));
+    minmax.update(sample);
+  }
+  CHECK_EQUAL(n, 40 + CAPACITY);
+  CHECK_EQUAL(minmax.getSamples(), CAPACITY);
+}
+
+void testMinMax() {
+  MinMax minmax;
+  CHECK_EQUAL(minmax.getSamples(), 0);
+  CHECK_EQUAL(minmax.getRange(), 0);
+  minmax.update(700);
+  CHECK_EQUAL(minmax.getRange(), 0);
+  minmax.update(100);
+  minmax.update(400);
+  CHECK_EQUAL(minmax.getMin(), 100);
+  CHECK_EQUAL(minmax.getMax(), 700);
+  CHECK_EQUAL(minmax.getRange(), 600);
+  CHECK_EQUAL(minmax.getSamples(), 3);
+  minmax.reset();
+  CHECK_EQUAL(minmax.getSamples(), 0);
+  CHECK_EQUAL(minmax.getRange(), 0);
+}
+
+int main() {
+  testStreams();
+  testFull();
+  testStalled();
+  testMinMax();
+  return finish("SampleRingTest");
+}
@@ -0,0 +1,236 @@
+/*
+ * SensorLink.h with a simulated Sensor board on Serial3: readings are collected without blocking, a request that goes
+ * unanswered times out after SENSOR_TIMEOUT_FRAMES and is retried on a new rising edge, and late, lost and corrupted
+ * readings are counted as such. The sketch keeps its frame rate while the Sensor board is gone.
+ */
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "HostTest.h"
+#include "FakeSensor.h"
+
+//frames run by step()
+long frame = 0;
+//readings held back by the fake sensor, and the frame to send each on
+std::deque<std::pair<long, std::vector<byte>>> delayed;
+
+//one frame of the sketch's use of the link: collect, then ask for the next reading. Returns true if a reading came.
+bool step(SensorLink& link) {
+  frame++;
+  host::advance(FRAME_MS * 1000UL);
+  while(!delayed.empty() && delayed.front().first <= frame) {
+    Serial3.feed(delayed.front().second.data(), delayed.front().second.size());
+    delayed.pop_front();
+  }
+  bool received = link.poll();
+  link.request();
+  return received;
+}
+
+void reset() {
+  Serial3.input.clear();
+  delayed.clear();
+  host::onDigitalWrite = NULL;
+  digitalWrite(FRAME_SIGNAL_DPIN, LOW);
+}
+
+//each request is answered straight away, and collected on the next frame
+void testAnswered() {
+  reset();
+  FakeSensor sensor;
+  sensor.attach();
+  sensor.source = [](SensorReading& reading) {
+    reading.lightlevel = 20;
+    reading.audiolevel = 300 + reading.sequence;
+    return true;
+  };
+  SensorLink link;
+  link.setup();
+  CHECK_EQUAL(sensor.requests, 1);
+  for(int i = 0; i < 100; i++) {
+    if(!CHECK(step(link))) break;
+    CHECK_EQUAL(link.getAudioLevel(), 300 + i);
+    CHECK_EQUAL(link.getLightLevel(), 20);
+  }
+  CHECK_EQUAL(sensor.requests, 101);
+  CHECK_EQUAL(link.getTimeouts(), 0);
+  CHECK_EQUAL(link.getDrops(), 0);
+  CHECK_EQUAL(link.getCrcErrors(), 0);
+}
+
+//an answer that comes within SENSOR_TIMEOUT_FRAMES is waited for, without asking again
+void testLate() {
+  for(int delay = 1; delay <= SENSOR_TIMEOUT_FRAMES; delay++) {
+    reset();
+    FakeSensor sensor;
+    sensor.attach();
+    sensor.source = [&](SensorReading& reading) {
+      byte buffer[SENSOR_MAX_FRAME];
+      reading.audiolevel = 500;
+      int length = encodeSensorReading(reading, buffer);
+      delayed.push_back(std::make_pair(frame + 1 + delay, std::vector<byte>(buffer, buffer + length)));
+      reading.sequence++;
+      return false;
+    };
+    SensorLink link;
+    link.setup();
+    for(int i = 0; i < delay; i++) CHECK(!step(link));
+    CHECK_EQUAL(sensor.requests, 1);
+    CHECK(step(link));
+    CHECK_EQUAL(link.getAudioLevel(), 500);
+    CHECK_EQUAL(link.getTimeouts(), 0);
+    //and the next request goes out on that frame
+    CHECK_EQUAL(sensor.requests, 2);
+  }
+}
+
+//no answer: the last values are kept, and after SENSOR_TIMEOUT_FRAMES the signal drops and is raised again
+void testTimeout() {
+  reset();
+  FakeSensor sensor;
+  sensor.attach();
+  sensor.reading.audiolevel = 123;
+  bool answer = true;
+  sensor.source = [&](SensorReading& reading) {
+    return answer;
+  };
+  SensorLink link;
+  link.setup();
+  answer = false;
+  CHECK(step(link));
+  unsigned long requests = sensor.requests;
+  for(int i = 0; i < SENSOR_TIMEOUT_FRAMES; i++) {
+    CHECK(!step(link));
+    CHECK_EQUAL(digitalRead(FRAME_SIGNAL_DPIN), HIGH);
+  }
+  CHECK_EQUAL(sensor.requests, requests);
+  CHECK_EQUAL(link.getTimeouts(), 0);
+  //the frame it gives up on, it asks again
+  CHECK(!step(link));
+  CHECK_EQUAL(link.getTimeouts(), 1);
+  CHECK_EQUAL(sensor.requests, requests + 1);
+  CHECK_EQUAL(link.getAudioLevel(), 123);
+  //a board that stays silent is asked every SENSOR_TIMEOUT_FRAMES + 1 frames
+  for(int i = 0; i < 10 * (SENSOR_TIMEOUT_FRAMES + 1); i++) CHECK(!step(link));
+  CHECK_EQUAL(link.getTimeouts(), 11);
+  CHECK_EQUAL(sensor.requests, requests + 11);
+  //and recovers on the frame after the next retry, once it answers
+  answer = true;
+  sensor.reading.audiolevel = 456;
+  int frames = 1;
+  while(!step(link) && frames <= SENSOR_TIMEOUT_FRAMES + 1) frames++;
+  CHECK_EQUAL(frames, SENSOR_TIMEOUT_FRAMES + 2);
+  CHECK_EQUAL(link.getAudioLevel(), 456);
+  CHECK_EQUAL(link.getTimeouts(), 12);
+  CHECK_EQUAL(link.getDrops(), 0);
+}
+
+//a reading split across frames is put back together
+void testSplit() {
+  reset();
+  FakeSensor sensor;
+  SensorLink link;
+  link.setup();
+  sensor.reading.audiolevel = 777;
+  byte buffer[SENSOR_MAX_FRAME];
+  int length = encodeSensorReading(sensor.reading, buffer);
+  Serial3.feed(buffer, 5);
+  CHECK(!step(link));
+  Serial3.feed(buffer + 5, length - 5);
+  CHECK(step(link));
+  CHECK_EQUAL(link.getAudioLevel(), 777);
+  CHECK_EQUAL(link.getTimeouts(), 0);
+}
+
+//an hour of a flaky Sensor board. Each answer is on time, late, missing, lost after being sent, or corrupted.
+//Every reading sent intact is collected, every failed request times out and is retried, and the losses are counted.
+void testFlaky() {
+  reset();
+  FakeSensor sensor;
+  sensor.attach();
+  SensorLink link;
+  uint32_t noise = 3;
+  long ontime = 0, late = 0, missing = 0, lost = 0, corrupted = 0;
+  sensor.source = [&](SensorReading& reading) {
+    noise = noise * 1103515245 + 12345;
+    int fate = (noise >> 16) % 100;
+    reading.audiolevel = (noise >> 8) % 1024;
+    if(fate < 70) {
+      ontime++;
+      return true;
+    }
+    byte buffer[SENSOR_MAX_FRAME];
+    int length = encodeSensorReading(reading, buffer);
+    if(fate < 85) {
+      late++;
+      long delay = 1 + (noise >> 24) % SENSOR_TIMEOUT_FRAMES;
+      delayed.push_back(std::make_pair(frame + 1 + delay, std::vector<byte>(buffer, buffer + length)));
+    } else if(fate < 92) {
+      missing++;
+      return false;
+    } else if(fate < 96) {
+      lost++;
+    } else {
+      corrupted++;
+      buffer[5] ^= 0x10;
+      Serial3.feed(buffer, length);
+    }
+    reading.sequence++;
+    return false;
+  };
+  link.setup();
+  long received = 0;
+  for(long i = 0; i < 3600L * 1000 / FRAME_MS; i++) {
+    if(step(link)) received++;
+  }
+  long failed = missing + lost + corrupted;
+  //the last request may still be outstanding
+  CHECK(received == ontime + late || received == ontime + late - 1);
+  CHECK(link.getTimeouts() == failed || link.getTimeouts() == failed - 1);
+  CHECK_EQUAL(sensor.requests, ontime + late + failed);
+  //a corrupted reading can hold a sync byte, which is tried as the start of a frame too
+  CHECK(link.getCrcErrors() >= corrupted);
+  //a reading missing from the sequence, because it was lost or rejected
+  CHECK(link.getDrops() == lost + corrupted || link.getDrops() == lost + corrupted - 1);
+  printf("%ld requests: %ld on time, %ld late, %ld missing, %ld lost, %ld corrupted, %u timeouts\n",
+         sensor.requests, ontime, late, missing, lost, corrupted, link.getTimeouts());
+}
+
+//the whole sketch with the Sensor board gone for a while: frames keep their rate, and the sound level model picks up
+//again when it's back
+void testSketch() {
+  reset();
+  host::now = 0;
+  host::clockcost = 20;
+  framenumber = 0;
+  patternenvironment.setFrameTime(0);
+  FakeSensor sensor;
+  sensor.attach();
+  bool present = true;
+  sensor.source = [&](SensorReading& reading) {
+    reading.audiolevel = 600;
+    return present;
+  };
+  setup();
+  long frames = framenumber;
+  uint64_t start = host::now;
+  while(host::now - start < 30000000ULL) {
+    present = host::now - start < 10000000ULL || host::now - start > 20000000ULL;
+    loop();
+  }
+  double rate = (framenumber - frames) / ((host::now - start) / 1e6);
+  CHECK_NEAR(rate, 1000.0 / FRAME_MS, 0.5);
+  CHECK(sensorlink.getTimeouts() >= 10 * 1000 / FRAME_MS / (SENSOR_TIMEOUT_FRAMES + 1) - 1);
+  CHECK_EQUAL(sensorlink.getAudioLevel(), 600);
+  CHECK_EQUAL(framescheduler.getResyncs(), 0);
+  host::clockcost = 1;
+}
+
+int main() {
+  testAnswered();
+  testLate();
+  testTimeout();
+  testSplit();
+  testFlaky();
+  testSketch();
+  return finish("SensorLinkTest");
+}
@@ -0,0 +1,41 @@
+/*
+ * Reads a log recorded by Tools/sensorlog.py, one record per frame, in the format described in LED/SensorLink.h.
+ * Include after the sketch.
+ */
+
+class SensorLog {
+
+    FILE* file;
+
+  public:
+    //records read so far
+    unsigned long records = 0;
+
+    SensorLog(FILE* f) {
+      file = f;
+    }
+
+    //reads the next record into record, which must hold 4 bytes, skipping anything else.
+    //Returns its length, or 0 at the end of the log.
+    int next(byte record[]) {
+      int type;
+      while((type = fgetc(file)) != EOF && type != SENSOR_LOG_READING && type != SENSOR_LOG_NONE);
+      if(type == EOF) return 0;
+      record[0] = type;
+      if(type == SENSOR_LOG_READING && fread(record + 1, 1, 3, file) < 3) return 0;
+      records++;
+      return type == SENSOR_LOG_READING ? 4 : 1;
+    }
+
+    //reads the next frame's levels into reading, if it has any.
+    //Returns SENSOR_LOG_READING, SENSOR_LOG_NONE for a frame logged without a reading, or 0 at the end of the log.
+    int next(SensorReading& reading) {
+      byte record[4];
+      int length = next(record);
+      if(length == 0) return 0;
+      if(length == 1) return SENSOR_LOG_NONE;
+      reading.lightlevel = record[1];
+      reading.audiolevel = record[2] | record[3] << 8;
+      return SENSOR_LOG_READING;
+    }
+};
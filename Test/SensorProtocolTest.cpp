@@ -0,0 +1,184 @@
+/*
+ * SensorProtocol.h: frames survive the trip from encoder to parser, and corrupted, truncated or misaligned data is
+ * rejected without losing the good frames after it.
+ */
+#include <Arduino.h>
+#include "../LED/SensorProtocol.h"
+#include "HostTest.h"
+
+SensorReading makeReading(byte sequence) {
+  SensorReading reading;
+  reading.sequence = sequence;
+  reading.lightlevel = 40 + sequence % 20;
+  reading.audiolevel = 1000 - sequence * 3;
+  reading.samples = 600 + sequence;
+  for(int i = 0; i < SENSOR_BANDS; i++) reading.bands[i] = sequence * 7 + i * 31;
+  return reading;
+}
+
+bool sameReading(const SensorReading& a, const SensorReading& b) {
+  return a.sequence == b.sequence && a.lightlevel == b.lightlevel && a.audiolevel == b.audiolevel &&
+         a.samples == b.samples && !memcmp(a.bands, b.bands, SENSOR_BANDS);
+}
+
+std::vector<byte> encode(const SensorReading& reading) {
+  byte frame[SENSOR_MAX_FRAME];
+  int length = encodeSensorReading(reading, frame);
+  return std::vector<byte>(frame, frame + length);
+}
+
+//feeds data to the parser, returning the readings it accepted
+std::vector<SensorReading> feed(SensorParser& parser, const std::vector<byte>& data) {
+  std::vector<SensorReading> readings;
+  for(byte b : data) {
+    if(parser.feed(b)) readings.push_back(parser.getReading());
+  }
+  return readings;
+}
+
+void append(std::vector<byte>& data, const std::vector<byte>& more) {
+  data.insert(data.end(), more.begin(), more.end());
+}
+
+void testRoundTrip() {
+  SensorParser parser;
+  for(int s = 0; s < 300; s++) {
+    SensorReading reading = makeReading(s);
+    std::vector<byte> frame = encode(reading);
+    CHECK_EQUAL(frame.size(), SENSOR_HEADER_SIZE + SENSOR_PAYLOAD_SIZE + 1);
+    //only the last byte completes the frame
+    std::vector<SensorReading> readings = feed(parser, std::vector<byte>(frame.begin(), frame.end() - 1));
+    CHECK(readings.empty());
+    CHECK(parser.feed(frame.back()));
+    CHECK(sameReading(parser.getReading(), reading));
+  }
+  CHECK_EQUAL(parser.getDrops(), 0);
+  CHECK_EQUAL(parser.getCrcErrors(), 0);
+}
+
+//every single bit error in a frame is rejected, and the frames after it still arrive
+void testBitFlips() {
+  std::vector<byte> frame = encode(makeReading(1));
+  for(size_t i = 0; i < frame.size(); i++) {
+    for(int bit = 0; bit < 8; bit++) {
+      SensorParser parser;
+      std::vector<byte> data = frame;
+      data[i] ^= 1 << bit;
+      for(int s = 2; s < 5; s++) append(data, encode(makeReading(s)));
+      std::vector<SensorReading> readings = feed(parser, data);
+      //a flip in the length may swallow the next frame, never the last
+      CHECK(readings.size() == 2 || readings.size() == 3);
+      for(size_t r = 0; r < readings.size(); r++) {
+        CHECK(sameReading(readings[r], makeReading(5 - readings.size() + r)));
+      }
+      //a corrupted sync byte isn't a frame at all, and a length over SENSOR_MAX_PAYLOAD is dropped unchecked,
+      //otherwise the CRC catches it
+      if(i > 0 && data[2] <= SENSOR_MAX_PAYLOAD) CHECK(parser.getCrcErrors() >= 1);
+    }
+  }
+}
+
+//a frame cut short at any point doesn't stop the next one being read
+void testTruncation() {
+  std::vector<byte> frame = encode(makeReading(1));
+  for(size_t length = 1; length < frame.size(); length++) {
+    SensorParser parser;
+    std::vector<byte> data(frame.begin(), frame.begin() + length);
+    append(data, encode(makeReading(2)));
+    std::vector<SensorReading> readings = feed(parser, data);
+    CHECK_EQUAL(readings.size(), 1);
+    if(!readings.empty()) CHECK(sameReading(readings[0], makeReading(2)));
+  }
+}
+
+//sync bytes in noise, or repeated before a frame, don't hide the frames
+void testStraySync() {
+  SensorParser parser;
+  std::vector<byte> data;
+  srand(7);
+  for(int s = 0; s < 50; s++) {
+    int noise = rand() % 6;
+    for(int i = 0; i < noise; i++) data.push_back(rand() % 3 == 0 ? SENSOR_SYNC : rand() % 256);
+    if(s % 5 == 0) data.push_back(SENSOR_SYNC);
+    append(data, encode(makeReading(s)));
+  }
+  std::vector<SensorReading> readings = feed(parser, data);
+  CHECK_EQUAL(readings.size(), 50);
+  for(size_t r = 0; r < readings.size() && r < 50; r++) CHECK(sameReading(readings[r], makeReading(r)));
+}
+
+//gaps in the sequence are counted as drops, including across the wrap at 255
+void testDrops() {
+  SensorParser parser;
+  std::vector<byte> data;
+  append(data, encode(makeReading(250)));
+  append(data, encode(makeReading(251)));
+  append(data, encode(makeReading(254)));
+  append(data, encode(makeReading(1)));
+  CHECK_EQUAL(feed(parser, data).size(), 4);
+  CHECK_EQUAL(parser.getDrops(), 2 + 2);
+}
+
+//frames from before bands were added read as silent, longer frames from later versions are read as far as known
+void testPayloadSizes() {
+  SensorParser parser;
+  SensorReading reading = makeReading(9);
+  std::vector<byte> frame = encode(reading);
+  //drop the bands
+  std::vector<byte> short_frame(frame.begin(), frame.begin() + SENSOR_HEADER_SIZE + SENSOR_MIN_PAYLOAD);
+  short_frame[2] = SENSOR_MIN_PAYLOAD;
+  byte crc = 0;
+  for(size_t i = 1; i < short_frame.size(); i++) crc = sensorCrc(crc, short_frame[i]);
+  short_frame.push_back(crc);
+  std::vector<SensorReading> readings = feed(parser, short_frame);
+  CHECK_EQUAL(readings.size(), 1);
+  if(!readings.empty()) {
+    CHECK_EQUAL(readings[0].audiolevel, reading.audiolevel);
+    for(int i = 0; i < SENSOR_BANDS; i++) CHECK_EQUAL(readings[0].bands[i], 0);
+  }
+  //add two unknown fields
+  std::vector<byte> long_frame(frame.begin(), frame.end() - 1);
+  long_frame[2] += 2;
+  long_frame[3] = 10;
+  long_frame.push_back(0x12);
+  long_frame.push_back(0x34);
+  crc = 0;
+  for(size_t i = 1; i < long_frame.size(); i++) crc = sensorCrc(crc, long_frame[i]);
+  long_frame.push_back(crc);
+  readings = feed(parser, long_frame);
+  CHECK_EQUAL(readings.size(), 1);
+  if(!readings.empty()) CHECK_EQUAL(readings[0].bands[7], reading.bands[7]);
+  //another version's frames are ignored
+  std::vector<byte> other = encode(makeReading(11));
+  other[1] = SENSOR_PROTOCOL_VERSION + 1;
+  crc = 0;
+  for(size_t i = 1; i < other.size() - 1; i++) crc = sensorCrc(crc, other[i]);
+  other.back() = crc;
+  CHECK(feed(parser, other).empty());
+  CHECK_EQUAL(parser.getCrcErrors(), 0);
+}
+
+//both sketches must use the same protocol
+void testCopiesMatch() {
+  std::string copies[2];
+  const char* paths[2] = {"../LED/SensorProtocol.h", "../Sensor/SensorProtocol.h"};
+  for(int i = 0; i < 2; i++) {
+    FILE* file = fopen(paths[i], "rb");
+    if(!check(file != NULL, paths[i], __FILE__, __LINE__)) return;
+    int c;
+    while((c = fgetc(file)) != EOF) copies[i] += char(c);
+    fclose(file);
+  }
+  CHECK(copies[0] == copies[1]);
+}
+
+int main() {
+  testRoundTrip();
+  testBitFlips();
+  testTruncation();
+  testStraySync();
+  testDrops();
+  testPayloadSizes();
+  testCopiesMatch();
+  return finish("SensorProtocolTest");
+}
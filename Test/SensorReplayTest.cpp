@@ -0,0 +1,172 @@
+/*
+ * SensorLink replaying a log (SENSOR_REPLAY): a record that arrives in pieces is waited for, a missing one times out,
+ * and a log played through the sketch drives the level model and playlists. A log with frames logged without a reading
+ * stays on its frames, replayed or sent by a fake Sensor board as Render.cpp does.
+ */
+#define SENSOR_SOURCE SENSOR_REPLAY
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "HostTest.h"
+#include "FakeSensor.h"
+#include "SensorLog.h"
+
+const byte READING[] = {SENSOR_LOG_READING, 12, 0x34, 0x01};
+
+//a record split in two arrives whole, however long the second half takes within the timeout
+void testSplitRecord() {
+  SensorLink link;
+  Serial.input.clear();
+  Serial.feed(READING, 2);
+  uint64_t start = host::now;
+  Serial.onAvailable = [&]() {
+    if(host::now - start > 200000 && Serial.input.size() == 2) Serial.feed(READING + 2, 2);
+  };
+  CHECK(link.poll());
+  Serial.onAvailable = NULL;
+  CHECK_EQUAL(link.getLightLevel(), 12);
+  CHECK_EQUAL(link.getAudioLevel(), 0x134);
+  CHECK(host::now - start >= 200000);
+  CHECK_EQUAL(link.getTimeouts(), 0);
+  CHECK(Serial.input.empty());
+}
+
+//with no record, poll() gives up after the timeout and keeps the last values
+void testTimeout() {
+  SensorLink link;
+  Serial.input.clear();
+  Serial.feed(READING, 4);
+  CHECK(link.poll());
+  uint64_t start = host::now;
+  CHECK(!link.poll());
+  //millis() only counts whole milliseconds
+  CHECK(host::now - start >= (SENSOR_REPLAY_TIMEOUT_MS - 1) * 1000UL);
+  CHECK_EQUAL(link.getTimeouts(), 1);
+  CHECK_EQUAL(link.getAudioLevel(), 0x134);
+  //an incomplete record also times out
+  Serial.feed(READING, 3);
+  CHECK(!link.poll());
+  CHECK_EQUAL(link.getTimeouts(), 2);
+  Serial.input.clear();
+}
+
+//a frame without a reading returns at once, and anything that isn't a record is skipped
+void testNoneAndJunk() {
+  SensorLink link;
+  Serial.input.clear();
+  const byte none[] = {SENSOR_LOG_NONE};
+  Serial.feed(none, 1);
+  uint64_t start = host::now;
+  CHECK(!link.poll());
+  CHECK(host::now - start < 1000);
+  Serial.feed("levels\n");
+  Serial.feed(READING, 4);
+  CHECK(link.poll());
+  CHECK_EQUAL(link.getAudioLevel(), 0x134);
+  CHECK_EQUAL(link.getTimeouts(), 0);
+}
+
+//plays a minute of quiet and a minute of loud through the sketch, answering each request as sensorlog.py does
+void testPlayback() {
+  host::clockcost = 20;
+  Serial.input.clear();
+  Serial.take();
+  setup();
+  long requests = 0;
+  for(int frame = 0; frame < 30 * 120; frame++) {
+    std::string written = Serial.take();
+    for(size_t i = 0; i < written.size(); i++) {
+      if(byte(written[i]) != SENSOR_LOG_REQUEST) continue;
+      requests++;
+      unsigned int audio = frame < 30 * 60 ? 30 : 120;
+      const byte record[] = {SENSOR_LOG_READING, 20, byte(audio & 255), byte(audio >> 8)};
+      Serial.feed(record, 4);
+    }
+    loop();
+    if(frame == 30 * 60 - 1) CHECK_EQUAL(soundlevel.getLevel(), 0);
+  }
+  //one request a frame, and one from setup()
+  CHECK_EQUAL(requests, 30 * 120);
+  CHECK_EQUAL(sensorlink.getTimeouts(), 0);
+  CHECK_EQUAL(soundlevel.getLevel(), 2);
+  CHECK_EQUAL(sensorlink.getLightLevel(), 20);
+}
+
+//frames in the logs with NONE records, and the audio level logged for a frame, or -1 for none
+const int LOGGED_FRAMES = 300;
+int loggedAudio(int frame) {
+  return frame % 7 == 3 || frame % 50 > 45 ? -1 : 100 + frame % 40;
+}
+
+//a log of LOGGED_FRAMES frames, some without a reading, ready to be read
+FILE* writeLog() {
+  FILE* file = tmpfile();
+  for(int frame = 0; frame < LOGGED_FRAMES; frame++) {
+    int audio = loggedAudio(frame);
+    if(audio < 0) {
+      fputc(SENSOR_LOG_NONE, file);
+      continue;
+    }
+    const byte record[] = {SENSOR_LOG_READING, 20, byte(audio & 255), byte(audio >> 8)};
+    fwrite(record, 1, 4, file);
+  }
+  rewind(file);
+  return file;
+}
+
+//replayed through the sketch, each frame takes one record, and frames after a NONE see their own reading
+void testNoneRecords() {
+  FILE* file = writeLog();
+  SensorLog log(file);
+  Serial.input.clear();
+  Serial.take();
+  setup();
+  unsigned int timeouts = sensorlink.getTimeouts();
+  int last = -1;
+  for(int frame = 0; frame < LOGGED_FRAMES; frame++) {
+    std::string written = Serial.take();
+    for(size_t i = 0; i < written.size(); i++) {
+      if(byte(written[i]) != SENSOR_LOG_REQUEST) continue;
+      byte record[4];
+      int length = log.next(record);
+      if(length) Serial.feed(record, length);
+    }
+    loop();
+    if(loggedAudio(frame) >= 0) last = loggedAudio(frame);
+    if(!CHECK_EQUAL(int(sensorlink.getAudioLevel()), last)) fprintf(stderr, "replayed frame %d\n", frame);
+  }
+  CHECK_EQUAL(log.records, LOGGED_FRAMES);
+  CHECK_EQUAL(sensorlink.getTimeouts(), timeouts);
+  fclose(file);
+}
+
+//played by a fake Sensor board as Render.cpp does, a record a frame, each reading is sent on its own frame
+void testRenderedLog() {
+  FILE* file = writeLog();
+  SensorLog log(file);
+  FakeSensor sensor;
+  SensorParser parser;
+  Serial3.input.clear();
+  for(int frame = 0; frame < LOGGED_FRAMES; frame++) {
+    int type = log.next(sensor.reading);
+    if(type == SENSOR_LOG_READING) sensor.send();
+    bool received = false;
+    while(Serial3.available()) {
+      if(parser.feed(Serial3.read())) received = true;
+    }
+    if(!CHECK_EQUAL(received, loggedAudio(frame) >= 0)) fprintf(stderr, "rendered frame %d\n", frame);
+    if(received) CHECK_EQUAL(int(parser.getReading().audiolevel), loggedAudio(frame));
+  }
+  CHECK_EQUAL(log.next(sensor.reading), 0);
+  CHECK_EQUAL(parser.getDrops(), 0);
+  fclose(file);
+}
+
+int main() {
+  testSplitRecord();
+  testTimeout();
+  testNoneAndJunk();
+  testPlayback();
+  testNoneRecords();
+  testRenderedLog();
+  return finish("SensorReplayTest");
+}
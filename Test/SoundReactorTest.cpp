@@ -0,0 +1,155 @@
+/*
+ * Audio.h: the fixed point SoundReactor follows the original floating point model, kept here as it was, over traces
+ * from silence to full scale. The rising gain table matches Kp_p^(1 - 5/max(5, level - 30)) across the whole range.
+ */
+#include <Arduino.h>
+#include "../LED/LED.ino"
+#include "HostTest.h"
+
+//the original model, without its debug output
+class FloatReactor {
+  public:
+    float audiolevel;
+    const float Kp_p = 0.015;
+    const float Kp_n = 0.003;
+    int currentlevel;
+    int prospective_level;
+    long prospective_level_time;
+    const int maxlevel = 2;
+    const int thresholds[2] = {45, 70};
+    const int threshold_negative_hysteresis[2] = {0, 0};
+    const int threshold_positive_hysteresis[2] = {5, 5};
+    const int level_minimum_duration_negative[2] = {30, 30};
+    const int level_minimum_duration_positive[2] = {2, 10};
+
+    FloatReactor() {
+      audiolevel = 70;
+      currentlevel = 1;
+      //the original left these unset
+      prospective_level = 1;
+      prospective_level_time = 0;
+    }
+
+    void update(float target) {
+      int error = target - audiolevel;
+      if(error > 0) {
+        audiolevel += pow(Kp_p, 1.0 - 5.0 / max(5, audiolevel - 30)) * error;
+      } else {
+        audiolevel += Kp_n * error;
+      }
+      updateLevel();
+    }
+
+    void updateLevel() {
+      //the original read past the ends of thresholds at level 0 and 2, for comparisons that were never used
+      int negative_threshold = currentlevel > 0 ?
+        thresholds[currentlevel-1] - threshold_negative_hysteresis[currentlevel-1] : 0;
+      int positive_threshold = currentlevel < maxlevel ?
+        thresholds[currentlevel] + threshold_positive_hysteresis[currentlevel] : 0;
+      if(currentlevel > 0 & audiolevel < negative_threshold) {
+        if(prospective_level != currentlevel-1) {
+          prospective_level = currentlevel-1;
+          prospective_level_time = millis();
+        }
+      } else if(currentlevel < maxlevel & audiolevel > positive_threshold) {
+        if(prospective_level != currentlevel+1) {
+          prospective_level = currentlevel+1;
+          prospective_level_time = millis();
+        }
+      } else {
+        prospective_level = currentlevel;
+      }
+      if(prospective_level < currentlevel &
+          millis() - prospective_level_time > level_minimum_duration_negative[currentlevel-1]*1000) {
+        currentlevel = prospective_level;
+      }
+      if(prospective_level > currentlevel &
+          millis() - prospective_level_time > level_minimum_duration_positive[currentlevel]*1000) {
+        currentlevel = prospective_level;
+      }
+    }
+};
+
+//a volume for each frame
+typedef std::function<int(long frame)> Trace;
+
+const long SECOND = 1000 / FRAME_MS;
+
+//repeatable noise, so a failure can be reproduced
+uint32_t noise = 1;
+int randomVolume(int low, int high) {
+  noise = noise * 1103515245 + 12345;
+  return low + (noise >> 16) % (high - low + 1);
+}
+
+double worstlevel = 0;
+long worstchange = 0;
+
+//runs a trace through both models. The audio levels agree within tolerance, and the levels change in the same order,
+//within a second of each other.
+void compare(const char* name, long frames, const Trace& trace, double tolerance) {
+  FloatReactor original;
+  SoundReactor reactor;
+  std::vector<std::pair<int, long>> originalchanges, changes;
+  for(long frame = 0; frame < frames; frame++) {
+    host::advance(FRAME_MS * 1000UL);
+    int volume = trace(frame);
+    original.update(volume);
+    reactor.update(volume);
+    double difference = fabs(reactor.audiolevel / 256.0 - original.audiolevel);
+    worstlevel = max(worstlevel, difference);
+    if(!CHECK_NEAR(reactor.audiolevel / 256.0, original.audiolevel, tolerance)) {
+      fprintf(stderr, "%s, frame %ld, volume %d\n", name, frame, volume);
+      return;
+    }
+    if(originalchanges.empty() ? original.currentlevel != 1 : originalchanges.back().first != original.currentlevel)
+      originalchanges.push_back(std::make_pair(original.currentlevel, frame));
+    if(changes.empty() ? reactor.getLevel() != 1 : changes.back().first != int(reactor.getLevel()))
+      changes.push_back(std::make_pair(int(reactor.getLevel()), frame));
+  }
+  if(!CHECK_EQUAL(changes.size(), originalchanges.size())) {
+    fprintf(stderr, "%s, level changes differ\n", name);
+    return;
+  }
+  for(size_t i = 0; i < changes.size(); i++) {
+    CHECK_EQUAL(changes[i].first, originalchanges[i].first);
+    long apart = labs(changes[i].second - originalchanges[i].second);
+    worstchange = max(worstchange, apart);
+    if(!CHECK(apart <= SECOND)) fprintf(stderr, "%s, change %d: %ld frames apart\n", name, int(i), apart);
+  }
+}
+
+int main() {
+  //the tables against the formula, over the whole range the model can reach. Each whole level is within rounding
+  //of it, and levels between are within 2% once the curve flattens out, 16 levels above 30.
+  SoundReactor reactor;
+  for(long above = 0; above <= 1000L << 8; above += 16) {
+    reactor.audiolevel = (30L << 8) + above;
+    double level = above / 256.0;
+    double exact = 4096 * pow(0.015, 1 - 5 / max(5.0, level));
+    double tolerance = (above & 255) == 0 ? 1.0 : level >= 16 ? exact * 0.02 : -1;
+    if(tolerance < 0) continue;
+    if(!CHECK_NEAR(reactor.risingGain(), exact, tolerance)) {
+      fprintf(stderr, "rising gain %.2f levels above 30\n", level);
+      break;
+    }
+  }
+
+  compare("steps", 600 * SECOND, [](long frame) {
+    static const int steps[] = {20, 60, 120, 40, 10, 80, 50, 30, 100, 0};
+    return steps[frame / (60 * SECOND)];
+  }, 1.5);
+  compare("noise", 600 * SECOND, [](long frame) {
+    int base = frame < 200 * SECOND ? 30 : frame < 400 * SECOND ? 60 : 90;
+    return randomVolume(base - 25, base + 25);
+  }, 1.5);
+  //a beat on a quiet background, the peaks take the level far into the coarse end of the gain table
+  compare("beats", 300 * SECOND, [](long frame) {
+    return frame % 15 == 0 ? randomVolume(300, 1023) : randomVolume(10, 40);
+  }, 1.5);
+  compare("full scale", 300 * SECOND, [](long frame) {
+    return frame < 60 * SECOND ? 1023 : frame < 150 * SECOND ? 0 : frame < 210 * SECOND ? 600 : 20;
+  }, 1.5);
+  printf("furthest from the float model: %.2f levels, level changes up to %ld frames apart\n", worstlevel, worstchange);
+  return finish("SoundReactorTest");
+}
@@ -0,0 +1,294 @@
+/*
+ * Just enough of the Arduino core to build the sketches on a PC, for the tests in Test/.
+ * Time is simulated: it only moves when the sketch reads the clock, delays, or a test calls host::advance(),
+ * so runs are repeatable and an hour of frames takes seconds. With HOST_REAL_CLOCK defined, the clock is the PC's
+ * instead, for timing code in Bench.cpp.
+ * Serial ports record what is written and read from a buffer the test fills.
+ *
+ * Unlike the AVR, int is 32 bits and long 64 bits here, so code that relies on 16 bit overflow behaves differently.
+ */
+#pragma once
+//standard headers first, Arduino's min/max/abs macros break them
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define pgm_read_byte(p)  (*(const uint8_t*)(p))
+#define pgm_read_word(p)  (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+#define pgm_read_ptr(p)   (*(void* const*)(p))
+#define memcpy_P memcpy
+
+#define HIGH   1
+#define LOW    0
+#define INPUT  0
+#define OUTPUT 1
+#define DEC    10
+#define HEX    16
+
+#define F_CPU 16000000L
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define abs(x) ((x) > 0 ? (x) : -(x))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define _BV(bit) (1 << (bit))
+
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper*)(s))
+
+/*
+ * The simulated board. Tests drive it through these.
+ */
+namespace host {
+  //simulated time, in microseconds
+  uint64_t now = 0;
+  //time each read of the clock takes, so busy waits end. Larger values make long runs faster.
+  unsigned long clockcost = 1;
+  //digital pin levels, and a hook called when the sketch writes one
+  byte pins[70];
+  std::function<void(int pin, int value)> onDigitalWrite;
+  //value analogRead() returns for each pin
+  int analog[16];
+
+  void advance(unsigned long us) {
+    now += us;
+  }
+};
+
+#ifdef HOST_REAL_CLOCK
+namespace host {
+  //the PC's monotonic clock, in nanoseconds
+  unsigned long nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+};
+
+unsigned long micros() {
+  return (unsigned long)(uint32_t)(host::nanos() / 1000);
+}
+
+unsigned long millis() {
+  return (unsigned long)(uint32_t)(host::nanos() / 1000000);
+}
+#else
+unsigned long micros() {
+  host::now += host::clockcost;
+  return (unsigned long)(uint32_t)host::now;
+}
+
+unsigned long millis() {
+  host::now += host::clockcost;
+  return (unsigned long)(uint32_t)(host::now / 1000);
+}
+#endif
+
+void delay(unsigned long ms) {
+  host::advance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  host::advance(us);
+}
+
+void pinMode(int pin, int mode) {
+}
+
+void digitalWrite(int pin, int value) {
+  bool changed = host::pins[pin] != value;
+  host::pins[pin] = value;
+  if(changed && host::onDigitalWrite) host::onDigitalWrite(pin, value);
+}
+
+int digitalRead(int pin) {
+  return host::pins[pin];
+}
+
+int analogRead(int pin) {
+  return host::analog[pin];
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+void randomSeed(unsigned long seed) {
+  srand(seed);
+}
+
+long random(long howbig) {
+  if(howbig == 0) return 0;
+  return rand() % howbig;
+}
+
+long random(long howsmall, long howbig) {
+  if(howsmall >= howbig) return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
+
+/*
+ * Arduino's String, for the debug messages built with +.
+ */
+class String {
+    std::string s;
+
+  public:
+    String(const char* c = "") : s(c) {
+    }
+    String(const std::string& c) : s(c) {
+    }
+    String(char c) : s(1, c) {
+    }
+    String(int v) : s(std::to_string(v)) {
+    }
+    String(unsigned int v) : s(std::to_string(v)) {
+    }
+    String(long v) : s(std::to_string(v)) {
+    }
+    String(unsigned long v) : s(std::to_string(v)) {
+    }
+    String(double v, int decimals = 2) {
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%.*f", decimals, v);
+      s = buffer;
+    }
+
+    String operator+(const String& other) const {
+      return String(s + other.s);
+    }
+    friend String operator+(const char* c, const String& other) {
+      return String(c + other.s);
+    }
+    const char* c_str() const {
+      return s.c_str();
+    }
+    unsigned int length() const {
+      return s.length();
+    }
+};
+
+/*
+ * A serial port. What the sketch writes is kept in output, what it reads is taken from input.
+ */
+class HardwareSerial {
+  public:
+    std::deque<uint8_t> input;
+    std::string output;
+    //if set, written bytes go here instead of output
+    FILE* sink = NULL;
+    //called each time the sketch checks for input
+    std::function<void()> onAvailable;
+
+    void begin(long baud) {
+    }
+    void end() {
+    }
+    operator bool() {
+      return true;
+    }
+
+    //queues bytes for the sketch to read
+    void feed(const void* data, size_t length) {
+      input.insert(input.end(), (const uint8_t*)data, (const uint8_t*)data + length);
+    }
+    void feed(const char* text) {
+      feed(text, strlen(text));
+    }
+
+    int available() {
+      if(onAvailable) onAvailable();
+      return input.size();
+    }
+    int peek() {
+      return input.empty() ? -1 : input.front();
+    }
+    int read() {
+      if(input.empty()) return -1;
+      int c = input.front();
+      input.pop_front();
+      return c;
+    }
+    void flush() {
+    }
+
+    size_t write(uint8_t c) {
+      if(sink) fputc(c, sink);
+      else output += char(c);
+      return 1;
+    }
+    size_t write(const uint8_t* data, size_t length) {
+      for(size_t i = 0; i < length; i++) write(data[i]);
+      return length;
+    }
+    size_t write(const char* text) {
+      return write((const uint8_t*)text, strlen(text));
+    }
+
+    size_t print(const char* text) {
+      return write(text);
+    }
+    size_t print(const __FlashStringHelper* text) {
+      return write((const char*)text);
+    }
+    size_t print(const String& text) {
+      return write(text.c_str());
+    }
+    size_t print(char c) {
+      return write(uint8_t(c));
+    }
+    size_t print(unsigned char v, int base = DEC) {
+      return print((unsigned long)v, base);
+    }
+    size_t print(int v, int base = DEC) {
+      return print(long(v), base);
+    }
+    size_t print(unsigned int v, int base = DEC) {
+      return print((unsigned long)v, base);
+    }
+    size_t print(long v, int base = DEC) {
+      if(base == DEC && v < 0) return print('-') + print((unsigned long)-v);
+      return print((unsigned long)v, base);
+    }
+    size_t print(unsigned long v, int base = DEC) {
+      char buffer[24];
+      snprintf(buffer, sizeof(buffer), base == HEX ? "%lX" : "%lu", v);
+      return write(buffer);
+    }
+    size_t print(double v, int decimals = 2) {
+      return print(String(v, decimals));
+    }
+    size_t println() {
+      return write("\r\n");
+    }
+    template<class T> size_t println(const T& v) {
+      return print(v) + println();
+    }
+    template<class T> size_t println(const T& v, int format) {
+      return print(v, format) + println();
+    }
+
+    //takes everything written so far
+    std::string take() {
+      std::string written;
+      written.swap(output);
+      return written;
+    }
+};
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+HardwareSerial Serial3;
@@ -0,0 +1,37 @@
+/*
+ * EEPROM backed by memory, erased (0xFF) at startup.
+ */
+#pragma once
+#include "Arduino.h"
+
+class EEPROMClass {
+  public:
+    uint8_t data[4096];
+
+    EEPROMClass() {
+      memset(data, 0xFF, sizeof(data));
+    }
+
+    uint8_t read(int address) {
+      return data[address];
+    }
+    void write(int address, uint8_t value) {
+      data[address] = value;
+    }
+    void update(int address, uint8_t value) {
+      data[address] = value;
+    }
+    template<class T> T& get(int address, T& t) {
+      memcpy(&t, data + address, sizeof(T));
+      return t;
+    }
+    template<class T> const T& put(int address, const T& t) {
+      memcpy(data + address, &t, sizeof(T));
+      return t;
+    }
+    unsigned int length() {
+      return sizeof(data);
+    }
+};
+
+EEPROMClass EEPROM;
@@ -0,0 +1,302 @@
+/*
+ * The parts of FastLED the sketch uses, with FastLED's integer maths so frames match the board's.
+ * show() only advances the simulated clock by host::showtime.
+ */
+#pragma once
+#include "Arduino.h"
+
+namespace host {
+  //time FastLED.show() takes, in microseconds
+  unsigned long showtime = 0;
+  //frames shown
+  unsigned long shows = 0;
+};
+
+typedef uint8_t fract8;
+
+inline uint8_t scale8(uint8_t i, fract8 scale) {
+  return (uint16_t(i) * (1 + uint16_t(scale))) >> 8;
+}
+
+//never scales a non-zero value to zero
+inline uint8_t scale8_video(uint8_t i, fract8 scale) {
+  return ((uint16_t(i) * scale) >> 8) + ((i && scale) ? 1 : 0);
+}
+
+inline uint8_t qadd8(uint8_t i, uint8_t j) {
+  unsigned int t = i + j;
+  return t > 255 ? 255 : t;
+}
+
+inline uint8_t qsub8(uint8_t i, uint8_t j) {
+  int t = i - j;
+  return t < 0 ? 0 : t;
+}
+
+inline uint8_t sin8(uint8_t theta) {
+  static const uint8_t b_m16_interleave[] = {0, 49, 49, 41, 90, 27, 117, 10};
+  uint8_t offset = theta;
+  if(theta & 0x40) offset = 255 - offset;
+  offset &= 0x3F;
+  uint8_t secoffset = offset & 0x0F;
+  if(theta & 0x40) secoffset++;
+  uint8_t section = offset >> 4;
+  uint8_t b = b_m16_interleave[section * 2];
+  uint8_t m16 = b_m16_interleave[section * 2 + 1];
+  uint8_t mx = (m16 * secoffset) >> 4;
+  int8_t y = mx + b;
+  if(theta & 0x80) y = -y;
+  y += 128;
+  return y;
+}
+
+inline uint8_t cos8(uint8_t theta) {
+  return sin8(theta + 64);
+}
+
+uint16_t rand16seed = 1337;
+
+inline uint8_t random8() {
+  rand16seed = rand16seed * 2053 + 13849;
+  return uint8_t(rand16seed + (rand16seed >> 8));
+}
+inline uint8_t random8(uint8_t lim) {
+  return (random8() * lim) >> 8;
+}
+inline uint8_t random8(uint8_t min, uint8_t lim) {
+  return min + random8(lim - min);
+}
+inline uint16_t random16() {
+  rand16seed = rand16seed * 2053 + 13849;
+  return rand16seed;
+}
+inline uint16_t random16(uint16_t lim) {
+  return (uint32_t(random16()) * lim) >> 16;
+}
+inline uint16_t random16(uint16_t min, uint16_t lim) {
+  return min + random16(lim - min);
+}
+
+struct CHSV {
+  union {
+    struct {
+      uint8_t h;
+      uint8_t s;
+      uint8_t v;
+    };
+    struct {
+      uint8_t hue;
+      uint8_t sat;
+      uint8_t val;
+    };
+    struct {
+      uint8_t hue_;
+      uint8_t saturation;
+      uint8_t value;
+    };
+  };
+
+  CHSV() {
+  }
+  CHSV(uint8_t ih, uint8_t is, uint8_t iv) : h(ih), s(is), v(iv) {
+  }
+};
+
+struct CRGB;
+void hsv2rgb_rainbow(const CHSV& hsv, CRGB& rgb);
+
+struct CRGB {
+  union {
+    struct {
+      uint8_t r;
+      uint8_t g;
+      uint8_t b;
+    };
+    uint8_t raw[3];
+  };
+
+  enum HTMLColorCode {
+    Black = 0x000000,
+    Blue  = 0x0000FF,
+    Green = 0x008000,
+    Red   = 0xFF0000,
+    White = 0xFFFFFF
+  };
+
+  CRGB() {
+  }
+  CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {
+  }
+  CRGB(uint32_t colorcode) : r(colorcode >> 16), g(colorcode >> 8), b(colorcode) {
+  }
+  CRGB(HTMLColorCode colorcode) : CRGB(uint32_t(colorcode)) {
+  }
+  CRGB(const CHSV& hsv) {
+    hsv2rgb_rainbow(hsv, *this);
+  }
+
+  CRGB& operator=(const CHSV& hsv) {
+    hsv2rgb_rainbow(hsv, *this);
+    return *this;
+  }
+  CRGB& operator=(uint32_t colorcode) {
+    return *this = CRGB(colorcode);
+  }
+
+  uint8_t& operator[](uint8_t x) {
+    return raw[x];
+  }
+  const uint8_t& operator[](uint8_t x) const {
+    return raw[x];
+  }
+
+  CRGB& setRGB(uint8_t nr, uint8_t ng, uint8_t nb) {
+    r = nr;
+    g = ng;
+    b = nb;
+    return *this;
+  }
+  CRGB& setHSV(uint8_t hue, uint8_t sat, uint8_t val) {
+    return *this = CHSV(hue, sat, val);
+  }
+
+  CRGB& operator+=(const CRGB& rhs) {
+    r = qadd8(r, rhs.r);
+    g = qadd8(g, rhs.g);
+    b = qadd8(b, rhs.b);
+    return *this;
+  }
+  CRGB& operator-=(const CRGB& rhs) {
+    r = qsub8(r, rhs.r);
+    g = qsub8(g, rhs.g);
+    b = qsub8(b, rhs.b);
+    return *this;
+  }
+  CRGB& nscale8(uint8_t scale) {
+    r = scale8(r, scale);
+    g = scale8(g, scale);
+    b = scale8(b, scale);
+    return *this;
+  }
+  CRGB& nscale8_video(uint8_t scale) {
+    r = scale8_video(r, scale);
+    g = scale8_video(g, scale);
+    b = scale8_video(b, scale);
+    return *this;
+  }
+  CRGB& fadeToBlackBy(uint8_t fade) {
+    return nscale8(255 - fade);
+  }
+  CRGB& operator%=(uint8_t scale) {
+    return nscale8_video(scale);
+  }
+
+  explicit operator bool() const {
+    return r || g || b;
+  }
+};
+
+inline bool operator==(const CRGB& a, const CRGB& b) {
+  return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+inline bool operator!=(const CRGB& a, const CRGB& b) {
+  return !(a == b);
+}
+inline CRGB operator+(const CRGB& a, const CRGB& b) {
+  return CRGB(a) += b;
+}
+
+//FastLED's rainbow hue mapping, with yellow boosted
+void hsv2rgb_rainbow(const CHSV& hsv, CRGB& rgb) {
+  const uint8_t K255 = 255;
+  const uint8_t K171 = 171;
+  const uint8_t K170 = 170;
+  const uint8_t K85 = 85;
+  uint8_t hue = hsv.hue;
+  uint8_t sat = hsv.sat;
+  uint8_t val = hsv.val;
+  uint8_t offset8 = (hue & 0x1F) << 3;
+  uint8_t third = scale8(offset8, 256 / 3);
+  uint8_t r, g, b;
+  if(!(hue & 0x80)) {
+    if(!(hue & 0x40)) {
+      if(!(hue & 0x20)) {
+        r = K255 - third; g = third; b = 0;
+      } else {
+        r = K171; g = K85 + third; b = 0;
+      }
+    } else {
+      if(!(hue & 0x20)) {
+        uint8_t twothirds = scale8(offset8, (256 * 2) / 3);
+        r = K171 - twothirds; g = K170 + third; b = 0;
+      } else {
+        r = 0; g = K255 - third; b = third;
+      }
+    }
+  } else {
+    if(!(hue & 0x40)) {
+      if(!(hue & 0x20)) {
+        uint8_t twothirds = scale8(offset8, (256 * 2) / 3);
+        r = 0; g = K171 - twothirds; b = K85 + twothirds;
+      } else {
+        r = third; g = 0; b = K255 - third;
+      }
+    } else {
+      if(!(hue & 0x20)) {
+        r = K85 + third; g = 0; b = K171 - third;
+      } else {
+        r = K170 + third; g = 0; b = K85 - third;
+      }
+    }
+  }
+  if(sat != 255) {
+    if(sat == 0) {
+      r = 255; g = 255; b = 255;
+    } else {
+      uint8_t desat = 255 - sat;
+      desat = scale8_video(desat, desat);
+      uint8_t satscale = 255 - desat;
+      r = scale8(r, satscale) + desat;
+      g = scale8(g, satscale) + desat;
+      b = scale8(b, satscale) + desat;
+    }
+  }
+  if(val != 255) {
+    val = scale8_video(val, val);
+    if(val == 0) {
+      r = 0; g = 0; b = 0;
+    } else {
+      r = scale8(r, val);
+      g = scale8(g, val);
+      b = scale8(b, val);
+    }
+  }
+  rgb.r = r;
+  rgb.g = g;
+  rgb.b = b;
+}
+
+inline void fill_solid(CRGB* leds, int count, const CRGB& colour) {
+  for(int i = 0; i < count; i++) leds[i] = colour;
+}
+
+enum EOrder { RGB, GRB };
+enum ESPIChipsets { NEOPIXEL, WS2812B };
+#define DISABLE_DITHER 0
+
+class CFastLED {
+  public:
+    template<int CHIPSET, int DATA_PIN> CFastLED& addLeds(CRGB* data, int count) {
+      return *this;
+    }
+    void setBrightness(uint8_t scale) {
+    }
+    void setDither(uint8_t dither) {
+    }
+    void show() {
+      host::advance(host::showtime);
+      host::shows++;
+    }
+};
+
+CFastLED FastLED;
@@ -0,0 +1,11 @@
+/*
+ * A transmit only SoftwareSerial, recording what is sent.
+ */
+#pragma once
+#include "Arduino.h"
+
+class SoftwareSerial: public HardwareSerial {
+  public:
+    SoftwareSerial(int receivepin, int transmitpin) {
+    }
+};
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""
+Turns frames streamed by the LED board (FRAME_EXPORT in LED/LED.ino, see LED/FrameExport.h) into images.
+Each frame is drawn as the tree unrolled, one column per strip with the bottom of the tree at the bottom,
+and the star above it.
+
+usage: frames.py /dev/ttyACM0 outdir [frames]   captures frames from the board (needs pyserial), default 300
+       frames.py capture.bin outdir             converts a previously captured stream
+       frames.py - outdir                       converts a stream from stdin, such as Test/build/Render's
+
+Frames are written as outdir/frame_000001.ppm, numbered by frame. To make a video or GIF:
+       ffmpeg -framerate 30 -i outdir/frame_%06d.ppm show.mp4
+If only some frames were kept, the numbers have gaps: use -pattern_type glob -i 'outdir/*.ppm' instead.
+"""
+import math
+import os
+import struct
+import sys
+
+BAUD = 1000000
+# size of each led in the image, in pixels
+SCALE = 8
+
+
+class Layout:
+    def __init__(self, header):
+        (self.version, self.rows, self.leds_per_row, self.rows_per_output, self.star_points,
+         self.star_point_leds, self.star_core_leds, self.star_center_leds) = header
+        if self.version != 1:
+            raise ValueError("unsupported frame export version %d" % self.version)
+        self.tree_leds = self.rows * self.leds_per_row
+        self.star_leds = (self.star_points * self.star_point_leds * 2 + self.star_points * self.star_core_leds
+                          + self.star_center_leds)
+        self.leds = self.tree_leds + self.star_leds
+        # star radius, in leds
+        self.core_radius = self.star_core_leds // 2 + 1
+        self.star_radius = self.core_radius + self.star_point_leds
+        self.star_size = (2 * self.star_radius + 1) * SCALE
+        self.width = max(self.rows * SCALE, self.star_size)
+        self.height = self.star_size + self.leds_per_row * SCALE
+        self.positions = [self.position(i) for i in range(self.leds)]
+
+    def position(self, led):
+        """top left pixel of a led, the same mapping as LED/LedCalculations.h"""
+        if led < self.tree_leds:
+            row, offset = divmod(led, self.leds_per_row)
+            upwards = row % self.rows_per_output % 2 == 0
+            height = offset if upwards else self.leds_per_row - 1 - offset
+            x = (self.width - self.rows * SCALE) // 2 + row * SCALE
+            return x, self.height - (height + 1) * SCALE
+        led -= self.tree_leds
+        point_leds = self.star_points * self.star_point_leds * 2
+        core_leds = self.star_points * self.star_core_leds
+        if led < point_leds:
+            # each point runs out from the core and back
+            point, pos = divmod(led, self.star_point_leds * 2)
+            out = pos < self.star_point_leds
+            radius = self.core_radius + (pos if out else self.star_point_leds * 2 - 1 - pos)
+            return self.star_position(point, radius, -0.5 if out else 0.5)
+        led -= point_leds
+        if led < core_leds:
+            point, pos = divmod(led, self.star_core_leds)
+            middle = self.star_core_leds // 2
+            return self.star_position(point, 1 + abs(pos - middle), (pos > middle) - (pos < middle))
+        led -= core_leds
+        return self.star_position(0, 0, led - (self.star_center_leds - 1) / 2)
+
+    def star_position(self, point, radius, side):
+        """led on a point of the star, side moves it across the point"""
+        angle = math.pi / 2 + 2 * math.pi * point / self.star_points
+        centre = self.width / 2, self.star_size / 2
+        x = centre[0] + radius * SCALE * math.cos(angle) + side * SCALE * math.sin(angle)
+        y = centre[1] - radius * SCALE * math.sin(angle) + side * SCALE * math.cos(angle)
+        return int(x - SCALE / 2), int(y - SCALE / 2)
+
+    def draw(self, colours):
+        image = bytearray(self.width * self.height * 3)
+        for led, (x, y) in enumerate(self.positions):
+            pixel = colours[led * 3:led * 3 + 3]
+            for row in range(max(y, 0), min(y + SCALE - 1, self.height)):
+                start = (row * self.width + max(x, 0)) * 3
+                count = min(x + SCALE - 1, self.width) - max(x, 0)
+                image[start:start + count * 3] = pixel * count
+        return image
+
+
+def find(stream, marker):
+    """skips anything else on Serial, up to marker"""
+    matched = 0
+    while matched < len(marker):
+        c = stream.read(1)
+        if not c:
+            return False
+        matched = matched + 1 if c[0] == marker[matched] else (1 if c[0] == marker[0] else 0)
+    return True
+
+
+def read_frames(stream, count=None):
+    if not find(stream, b"LED"):
+        raise EOFError("no frame export layout found")
+    layout = Layout(stream.read(8))
+    yield layout
+    read = 0
+    while count is None or read < count:
+        if not find(stream, b"FR"):
+            return
+        data = stream.read(4 + layout.leds * 3)
+        if len(data) < 4 + layout.leds * 3:
+            return
+        yield struct.unpack("<I", data[:4])[0], data[4:]
+        read += 1
+
+
+def write_frames(frames, outdir):
+    os.makedirs(outdir, exist_ok=True)
+    layout = next(frames)
+    written = 0
+    for number, colours in frames:
+        with open(os.path.join(outdir, "frame_%06d.ppm" % number), "wb") as f:
+            f.write(b"P6 %d %d 255\n" % (layout.width, layout.height))
+            f.write(layout.draw(colours))
+        written += 1
+    print("%d frames written to %s" % (written, outdir))
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        print(__doc__)
+        sys.exit(1)
+    path, outdir = sys.argv[1], sys.argv[2]
+    if path.startswith("/dev/") or path.upper().startswith("COM"):
+        import serial
+        count = int(sys.argv[3]) if len(sys.argv) == 4 else 300
+        # opening the port resets the board, so the layout record is sent again
+        with serial.Serial(path, BAUD, timeout=5) as port:
+            write_frames(read_frames(port, count), outdir)
+    elif path == "-":
+        write_frames(read_frames(sys.stdin.buffer), outdir)
+    else:
+        with open(path, "rb") as f:
+            write_frames(read_frames(f), outdir)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""
+Records and replays the Sensor board readings the LED board uses, one record per frame (see LED/SensorLink.h).
+
+usage: sensorlog.py capture /dev/ttyACM0 party.log   records while SENSOR_SOURCE is SENSOR_CAPTURE, until ctrl-c
+       sensorlog.py replay /dev/ttyACM0 party.log    feeds the log back while SENSOR_SOURCE is SENSOR_REPLAY
+       sensorlog.py show party.log                   prints the log, one line a second
+Needs pyserial to talk to the board. To see the levels and patterns the LED sketch picks for a log without a board,
+play it through the host build: make -C Test replay && Test/build/Replay party.log
+"""
+import sys
+
+BAUD = 9600
+READING = 0xF0
+NONE = 0xF1
+REQUEST = 0xF2
+FRAMES_PER_SECOND = 30
+
+
+def read_records(read):
+    """yields (light, audio) for frames with a reading, and None for frames without, skipping anything else"""
+    while True:
+        c = read(1)
+        if not c:
+            return
+        if c[0] == NONE:
+            yield None
+        elif c[0] == READING:
+            data = read(3)
+            if len(data) < 3:
+                return
+            yield data[0], data[1] | data[2] << 8
+
+
+def encode(record):
+    if record is None:
+        return bytes([NONE])
+    light, audio = record
+    return bytes([READING, light, audio & 255, audio >> 8])
+
+
+def capture(port, path):
+    frames = 0
+    with open(path, "wb") as log:
+        try:
+            for record in read_records(port.read):
+                log.write(encode(record))
+                frames += 1
+                if frames % (FRAMES_PER_SECOND * 10) == 0:
+                    log.flush()
+                    print("%d seconds captured" % (frames // FRAMES_PER_SECOND))
+        except KeyboardInterrupt:
+            pass
+    print("%d frames captured" % frames)
+
+
+def replay(port, path):
+    with open(path, "rb") as log:
+        records = list(read_records(log.read))
+    print("replaying %d frames" % len(records))
+    sent = 0
+    while sent < len(records):
+        c = port.read(1)
+        if c and c[0] == REQUEST:
+            port.write(encode(records[sent]))
+            sent += 1
+            if sent % (FRAMES_PER_SECOND * 10) == 0:
+                print("%d seconds replayed" % (sent // FRAMES_PER_SECOND))
+    print("replay done")
+
+
+def show(path):
+    with open(path, "rb") as log:
+        records = list(read_records(log.read))
+    print("%6s %8s %8s %8s" % ("second", "light", "audio", "missed"))
+    for start in range(0, len(records), FRAMES_PER_SECOND):
+        second = records[start:start + FRAMES_PER_SECOND]
+        readings = [r for r in second if r is not None]
+        light = sum(r[0] for r in readings) / len(readings) if readings else 0
+        audio = max((r[1] for r in readings), default=0)
+        print("%6d %8.1f %8d %8d" % (start // FRAMES_PER_SECOND, light, audio, len(second) - len(readings)))
+
+
+def main():
+    if len(sys.argv) == 3 and sys.argv[1] == "show":
+        show(sys.argv[2])
+    elif len(sys.argv) == 4 and sys.argv[1] in ("capture", "replay"):
+        import serial
+        with serial.Serial(sys.argv[2], BAUD, timeout=1) as port:
+            (capture if sys.argv[1] == "capture" else replay)(port, sys.argv[3])
+    else:
+        print(__doc__)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
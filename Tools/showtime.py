@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+"""
+Estimates FastLED.show() time for each way of splitting the tree across LED_OUTPUTS data pins,
+using the same model as showTimeUs() in LED/LedOutputs.h.
+
+usage: showtime.py [rows] [leds_per_row] [star_leds]
+"""
+import sys
+
+# ws2812b: 24 bits at 1.25us per led, and the latch gap after each output
+LED_TIME_US = 30
+LATCH_TIME_US = 50
+FRAME_TIME_US = 33000
+
+
+def show_time(rows, leds_per_row, star_leds, outputs, parallel):
+    longest = rows // outputs * leds_per_row + star_leds
+    if parallel:
+        return longest * LED_TIME_US + LATCH_TIME_US
+    return (rows * leds_per_row + star_leds) * LED_TIME_US + outputs * LATCH_TIME_US
+
+
+def main():
+    # defaults match LED/Common.h
+    rows = int(sys.argv[1]) if len(sys.argv) > 1 else 16
+    leds_per_row = int(sys.argv[2]) if len(sys.argv) > 2 else 30
+    star_leds = int(sys.argv[3]) if len(sys.argv) > 3 else 67
+    print("outputs  sequential(us)  parallel(us)  parallel frame share")
+    for outputs in range(1, rows + 1):
+        if rows % outputs:
+            continue
+        sequential = show_time(rows, leds_per_row, star_leds, outputs, False)
+        parallel = show_time(rows, leds_per_row, star_leds, outputs, True)
+        print("%7d  %14d  %12d  %19.0f%%" % (outputs, sequential, parallel, 100.0 * parallel / FRAME_TIME_US))
+    print("The AVR FastLED driver sends outputs one after another, so the Mega always gets the sequential time.")
+
+
+if __name__ == "__main__":
+    main()
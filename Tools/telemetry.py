@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+Decodes frame telemetry from the LED board (see LED/Telemetry.h).
+
+usage: telemetry.py /dev/ttyACM0   requests a dump from the board (needs pyserial)
+       telemetry.py dump.bin       decodes a previously captured dump
+"""
+import struct
+import sys
+
+STAGES = ["sensor", "pattern", "overlay", "output", "show"]
+# in the order of PATTERNS::PATTERN in LED/PatternManager.h
+PATTERNS = ["blank", "ornaments", "chase1", "chase2", "flashrow", "flashring", "radio", "eye", "fire", "bouncingball",
+            "loudness", "fallingstar", "sparkle", "wiggle", "diagonal", "fireworks", "altstripes", "swirlpaint",
+            "testpattern"]
+
+
+def read_dump(stream):
+    # skip anything printed before the dump
+    while True:
+        c = stream.read(1)
+        if not c:
+            raise EOFError("no telemetry found")
+        if c == b"T":
+            break
+    version, stages, frames, buckets, bucket_ms = stream.read(5)
+    if version != 4:
+        raise ValueError("unsupported telemetry version %d" % version)
+
+    def words(n):
+        return list(struct.unpack("<%dH" % n, stream.read(2 * n)))
+
+    dump = {
+        "minimum": words(stages),
+        "maximum": words(stages),
+        "histogram": words(buckets),
+        "bucket_ms": bucket_ms,
+        "overruns": words(1)[0],
+        "frames": [words(stages) for _ in range(frames)],
+        "fps": stream.read(1)[0],
+    }
+    dump["drops"], dump["resyncs"] = words(2)
+    dump["sensor_drops"], dump["crc_errors"], dump["timeouts"] = words(3)
+    dump["costs"] = words(stream.read(1)[0])
+    return dump
+
+
+def stage_name(i):
+    return STAGES[i] if i < len(STAGES) else "stage%d" % i
+
+
+def pattern_name(i):
+    return PATTERNS[i] if i < len(PATTERNS) else "pattern%d" % i
+
+
+def report(dump):
+    print("%-8s %8s %8s %8s" % ("stage", "min(us)", "max(us)", "avg(us)"))
+    frames = dump["frames"]
+    for s in range(len(dump["minimum"])):
+        avg = sum(f[s] for f in frames) / len(frames) if frames else 0
+        print("%-8s %8d %8d %8d" % (stage_name(s), dump["minimum"][s], dump["maximum"][s], avg))
+    print("overruns: %d" % dump["overruns"])
+    print("frames shown last second: %d, not shown: %d, fell behind: %d" % (dump["fps"], dump["drops"], dump["resyncs"]))
+    print("sensor readings lost: %d, corrupt: %d, timed out: %d" %
+          (dump["sensor_drops"], dump["crc_errors"], dump["timeouts"]))
+    print("frame time histogram:")
+    last = len(dump["histogram"]) - 1
+    for i, count in enumerate(dump["histogram"]):
+        low = i * dump["bucket_ms"]
+        label = "%d+ms" % low if i == last else "%d-%dms" % (low, low + dump["bucket_ms"])
+        print("  %-8s %d" % (label, count))
+    print("recent frames (us), oldest first:")
+    print("  " + " ".join("%8s" % stage_name(s) for s in range(len(dump["minimum"]))) + "    total")
+    for f in frames:
+        print("  " + " ".join("%8d" % t for t in f) + " %8d" % sum(f))
+    print("average pattern update (us), patterns run so far:")
+    for i, cost in enumerate(dump["costs"]):
+        if cost:
+            print("  %-14s %8d" % (pattern_name(i), cost))
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__)
+        sys.exit(1)
+    path = sys.argv[1]
+    if path.startswith("/dev/") or path.upper().startswith("COM"):
+        import serial
+        with serial.Serial(path, 9600, timeout=2) as port:
+            port.reset_input_buffer()
+            port.write(b"T\n")
+            report(read_dump(port))
+    else:
+        with open(path, "rb") as f:
+            report(read_dump(f))
+
+
+if __name__ == "__main__":
+    main()